@@ -2,22 +2,48 @@
 
 #include <iostream>
 #include <vector>
+#include <array>
 #include <string>
 #include <cstdint>
+#include <cstring>
+#include <cstddef>
 #include <memory>
+#include <new>
 #include <map>
 #include <random>
 #include <cassert>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 // Security parameter (key length in bits)
 constexpr size_t SECURITY_PARAM = 128;
 constexpr size_t WIRE_LABEL_SIZE = SECURITY_PARAM / 8; // 16 bytes
 
 // Network constants
 constexpr int DEFAULT_PORT = 8080;
-constexpr int MAX_MESSAGE_SIZE = 65536;
+// Messages travel as frames of at most MAX_FRAME_SIZE payload bytes with a
+// 64-bit length; a reassembled message may reach MAX_MESSAGE_SIZE
+constexpr size_t MAX_FRAME_SIZE = 1 << 20;
+constexpr uint64_t MAX_MESSAGE_SIZE = 1ULL << 32;
 constexpr int SOCKET_TIMEOUT = 30; // seconds
 
+// Streamed garbled tables: bytes per chunk and chunks queued for the sender
+constexpr size_t STREAM_CHUNK_BYTES = 1 << 20;
+constexpr size_t STREAM_QUEUE_DEPTH = 4;
+
+// Garbled tables striped over parallel data connections: bytes per striped
+// chunk, and data connections a session may open
+constexpr size_t STRIPE_CHUNK_BYTES = 1 << 20;
+constexpr size_t MAX_STRIPES = 64;
+
+// Gates whose hashes are computed together in one batched PRF pass
+constexpr size_t GATE_BATCH_SIZE = 256;
+
+// Circuit instances a garbling pool garbles together (Garbler::garble_circuits)
+constexpr size_t POOL_GARBLE_LANES = 8;
+
 // Gate types
 enum class GateType {
     AND = 0,
@@ -30,8 +56,74 @@ enum class GateType {
     OUTPUT = 7
 };
 
-// Wire label type - 128-bit label
-using WireLabel = std::array<uint8_t, WIRE_LABEL_SIZE>;
+// Wire label type - 128-bit label, 16-byte aligned so it fits one SSE register.
+// XOR, comparison and select work on the whole vector; the byte view (data(),
+// operator[], iterators) is for serialization and hashing boundaries.
+// WireLabel{} is all zero, a default-initialized WireLabel is left uninitialized.
+struct alignas(16) WireLabel {
+    WireLabel() = default;
+    
+#if defined(__SSE2__)
+    explicit WireLabel(__m128i v) { _mm_store_si128(reinterpret_cast<__m128i*>(bytes_), v); }
+    __m128i vec() const { return _mm_load_si128(reinterpret_cast<const __m128i*>(bytes_)); }
+#endif
+    
+    uint8_t* data() { return bytes_; }
+    const uint8_t* data() const { return bytes_; }
+    static constexpr size_t size() { return WIRE_LABEL_SIZE; }
+    uint8_t* begin() { return bytes_; }
+    uint8_t* end() { return bytes_ + WIRE_LABEL_SIZE; }
+    const uint8_t* begin() const { return bytes_; }
+    const uint8_t* end() const { return bytes_ + WIRE_LABEL_SIZE; }
+    uint8_t& operator[](size_t i) { return bytes_[i]; }
+    const uint8_t& operator[](size_t i) const { return bytes_[i]; }
+    
+    WireLabel& operator^=(const WireLabel& other) {
+#if defined(__SSE2__)
+        *this = WireLabel(_mm_xor_si128(vec(), other.vec()));
+#else
+        uint64_t a[2], b[2];
+        std::memcpy(a, bytes_, WIRE_LABEL_SIZE);
+        std::memcpy(b, other.bytes_, WIRE_LABEL_SIZE);
+        a[0] ^= b[0];
+        a[1] ^= b[1];
+        std::memcpy(bytes_, a, WIRE_LABEL_SIZE);
+#endif
+        return *this;
+    }
+    
+    friend WireLabel operator^(WireLabel a, const WireLabel& b) { return a ^= b; }
+    
+    friend bool operator==(const WireLabel& a, const WireLabel& b) {
+#if defined(__SSE2__)
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(a.vec(), b.vec())) == 0xFFFF;
+#else
+        return std::memcmp(a.bytes_, b.bytes_, WIRE_LABEL_SIZE) == 0;
+#endif
+    }
+    
+    friend bool operator!=(const WireLabel& a, const WireLabel& b) { return !(a == b); }
+    
+    // bit ? if1 : if0 without a branch on the (often secret-dependent) bit
+    static WireLabel select(bool bit, const WireLabel& if0, const WireLabel& if1) {
+#if defined(__SSE2__)
+        __m128i mask = _mm_set1_epi8(static_cast<char>(-static_cast<int>(bit)));
+        return WireLabel(_mm_xor_si128(if0.vec(), _mm_and_si128(mask, _mm_xor_si128(if0.vec(), if1.vec()))));
+#else
+        WireLabel out;
+        uint8_t mask = static_cast<uint8_t>(-static_cast<int>(bit));
+        for (size_t i = 0; i < WIRE_LABEL_SIZE; ++i) {
+            out.bytes_[i] = if0.bytes_[i] ^ (mask & (if0.bytes_[i] ^ if1.bytes_[i]));
+        }
+        return out;
+#endif
+    }
+    
+private:
+    uint8_t bytes_[WIRE_LABEL_SIZE];
+};
+
+static_assert(sizeof(WireLabel) == WIRE_LABEL_SIZE, "WireLabel must be exactly one 128-bit block");
 
 // Gate structure
 struct Gate {
@@ -47,7 +139,10 @@ struct Gate {
         : output_wire(out), input_wire1(in1), input_wire2(-1), type(t) {}
 };
 
-// Circuit structure
+// Circuit structure. Once loaded, wires are numbered densely from 1: inputs are
+// 1..num_inputs and gate i writes wire num_inputs + 1 + i (see
+// CircuitUtils::renumber_wires), so per-wire state lives in vectors of
+// num_wires + 1 entries indexed by wire id
 struct Circuit {
     int num_inputs;
     int num_outputs; 
@@ -60,27 +155,170 @@ struct Circuit {
     Circuit() : num_inputs(0), num_outputs(0), num_gates(0), num_wires(0) {}
 };
 
-// Garbled gate structure (4 ciphertexts)
-struct GarbledGate {
-    std::array<std::vector<uint8_t>, 4> ciphertexts;
+// Allocator handing out storage aligned to Align bytes (C++17 aligned new)
+template <typename T, size_t Align>
+struct AlignedAllocator {
+    using value_type = T;
+    template <typename U> struct rebind { using other = AlignedAllocator<U, Align>; };
     
-    GarbledGate() {
-        for (auto& ct : ciphertexts) {
-            ct.resize(WIRE_LABEL_SIZE + 16); // Label + padding for verification
-        }
+    AlignedAllocator() = default;
+    template <typename U> AlignedAllocator(const AlignedAllocator<U, Align>&) {}
+    
+    T* allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Align)));
+    }
+    void deallocate(T* p, size_t) { ::operator delete(p, std::align_val_t(Align)); }
+    
+    // Default-initialize, so resize() leaves bytes to be received or garbled
+    // into unwritten instead of zero-filling them first
+    template <typename U> void construct(U* p) { ::new (static_cast<void*>(p)) U; }
+    template <typename U, typename... Args> void construct(U* p, Args&&... args) {
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
     }
+    
+    template <typename U> bool operator==(const AlignedAllocator<U, Align>&) const { return true; }
+    template <typename U> bool operator!=(const AlignedAllocator<U, Align>&) const { return false; }
+};
+
+// Cache-line aligned byte buffer holding the garbled tables of a whole circuit
+using TableBuffer = std::vector<uint8_t, AlignedAllocator<uint8_t, 64>>;
+
+// Byte buffer of a received message; resize() leaves the bytes unwritten for
+// the frames to be received into
+using MessageBuffer = std::vector<uint8_t, AlignedAllocator<uint8_t, alignof(std::max_align_t)>>;
+
+// View of one gate's garbled table inside GarbledCircuit::tables (4 ciphertexts
+// at most). Rows sit at a fixed stride; the three-halves control row is a single
+// byte after the three half-ciphertexts. Free gates have rows == 0.
+template <typename Byte>
+struct GateTableView {
+    Byte* data = nullptr;
+    size_t rows = 0;
+    size_t stride = 0;
+    
+    GateTableView() = default;
+    GateTableView(Byte* d, size_t r, size_t s) : data(d), rows(r), stride(s) {}
+    
+    // A writable view converts to a read-only one
+    template <typename Other>
+    GateTableView(const GateTableView<Other>& other) : data(other.data), rows(other.rows), stride(other.stride) {}
+    
+    Byte* row(size_t r) const { return data + r * stride; }
 };
 
+using GarbledGate = GateTableView<uint8_t>;
+using ConstGarbledGate = GateTableView<const uint8_t>;
+
+// Garbling scheme used for non-free gates (AND, OR, NAND)
+enum class GarblingScheme : uint8_t {
+    STANDARD = 0,   // Garbled truth table (classic or point-and-permute)
+    HALF_GATES = 1, // Two 16-byte ciphertexts per gate, needs free-XOR and point-and-permute
+    THREE_HALVES = 2 // Three 8-byte half-ciphertexts plus a control byte (Rosulek-Roy), same requirements
+};
+
+// Three-halves tables: rows 0-2 hold half-label ciphertexts, row 3 the encrypted control bits
+constexpr size_t THREE_HALVES_CONTROL_ROW = 3;
+
+// Garbling mode flags carried in the serialized circuit header
+// (the upper nibble holds the GarblingScheme)
+constexpr uint8_t GC_FLAG_POINT_AND_PERMUTE = 0x01;
+constexpr uint8_t GC_FLAG_FREE_XOR = 0x02;
+constexpr uint8_t GC_FLAG_STREAMED = 0x04; // Tables follow the input labels and OT, in chunks
+
 // Garbled circuit structure  
 struct GarbledCircuit {
     Circuit circuit;
-    std::vector<GarbledGate> garbled_gates;
-    std::map<int, std::pair<WireLabel, WireLabel>> input_labels; // wire_id -> (label0, label1)
-    std::map<int, WireLabel> output_mapping; // For output decoding
+    // Every gate's table back to back in gate order, gate i at
+    // tables[table_offsets[i] .. table_offsets[i + 1]); sent and received as is.
+    // A streamed circuit has the offsets but no tables (they travel in chunks)
+    TableBuffer tables;
+    std::vector<size_t> table_offsets;
+    std::vector<std::pair<WireLabel, WireLabel>> input_labels; // input wire_id -> (label0, label1), slot 0 unused
+    std::vector<WireLabel> output_mapping; // label0 of circuit.output_wires[i], for output decoding
+    bool point_and_permute = false;
+    bool free_xor = false; // label1 = label0 ^ delta on every wire
+    GarblingScheme scheme = GarblingScheme::STANDARD;
+    bool streamed = false; // Tables are sent after the inputs and evaluated as they arrive
     
     GarbledCircuit() = default;
-    GarbledCircuit(const Circuit& c) : circuit(c) {
-        garbled_gates.resize(c.gates.size());
+    GarbledCircuit(const Circuit& c) : circuit(c) {}
+    
+    // With free-XOR, XOR and NOT gates are evaluated without a garbled table
+    bool is_free_gate(GateType type) const {
+        return free_xor && (type == GateType::XOR || type == GateType::NOT);
+    }
+    
+    // Table layout of a gate: number of ciphertexts and bytes per ciphertext
+    size_t table_rows(GateType type) const {
+        if (is_free_gate(type)) return 0;
+        if (scheme == GarblingScheme::HALF_GATES) return 2;
+        // GRR3: with point-and-permute, row 0 of a binary gate is implied and not sent
+        if (scheme == GarblingScheme::STANDARD && point_and_permute && type != GateType::NOT) return 3;
+        return 4;
+    }
+    
+    size_t ciphertext_size(size_t row = 0) const {
+        switch (scheme) {
+            case GarblingScheme::HALF_GATES:
+                return WIRE_LABEL_SIZE;
+            case GarblingScheme::THREE_HALVES:
+                return row == THREE_HALVES_CONTROL_ROW ? 1 : WIRE_LABEL_SIZE / 2;
+            default:
+                // Point-and-permute rows are one-time-pad labels, classic rows carry padding
+                return point_and_permute ? WIRE_LABEL_SIZE : WIRE_LABEL_SIZE + 16;
+        }
+    }
+    
+    // Bytes of a gate's table (three-halves: 3 half-ciphertexts + control byte)
+    size_t table_size(GateType type) const {
+        size_t rows = table_rows(type);
+        if (rows == 0) return 0;
+        return (rows - 1) * ciphertext_size(0) + ciphertext_size(rows - 1);
+    }
+    
+    // Table offsets of the circuit's gates under the current mode flags; call once
+    // the flags are set. layout_tables() also sizes the arena, before garbling or
+    // receiving the tables
+    void compute_table_offsets() {
+        table_offsets.resize(circuit.gates.size() + 1);
+        size_t offset = 0;
+        for (size_t i = 0; i < circuit.gates.size(); ++i) {
+            table_offsets[i] = offset;
+            offset += table_size(circuit.gates[i].type);
+        }
+        table_offsets[circuit.gates.size()] = offset;
+    }
+    
+    void layout_tables() {
+        compute_table_offsets();
+        tables.assign(table_bytes(), 0);
+    }
+    
+    size_t table_bytes() const { return table_offsets.empty() ? 0 : table_offsets.back(); }
+    
+    GarbledGate gate_table(size_t i) {
+        return gate_table(i, tables.data(), 0);
+    }
+    
+    ConstGarbledGate gate_table(size_t i) const {
+        return gate_table(i, tables.data(), 0);
+    }
+    
+    // Gate i's table inside a buffer holding the arena bytes from window_start on,
+    // such as one streamed chunk
+    GarbledGate gate_table(size_t i, uint8_t* window, size_t window_start) const {
+        return GarbledGate(window + (table_offsets[i] - window_start), table_rows(circuit.gates[i].type), ciphertext_size(0));
+    }
+    
+    ConstGarbledGate gate_table(size_t i, const uint8_t* window, size_t window_start) const {
+        return ConstGarbledGate(window + (table_offsets[i] - window_start), table_rows(circuit.gates[i].type), ciphertext_size(0));
+    }
+    
+    uint8_t mode_flags() const {
+        return (point_and_permute ? GC_FLAG_POINT_AND_PERMUTE : 0) |
+               (free_xor ? GC_FLAG_FREE_XOR : 0) |
+               (streamed ? GC_FLAG_STREAMED : 0) |
+               (static_cast<uint8_t>(scheme) << 4);
     }
 };
 
@@ -93,17 +331,18 @@ enum class MessageType : uint8_t {
     OT_RESPONSE = 4,
     RESULT = 5,
     ERROR = 6,
-    GOODBYE = 7
+    GOODBYE = 7,
+    STRIPES = 8
 };
 
 // Network message structure
 struct Message {
     MessageType type;
-    uint32_t size;
-    std::vector<uint8_t> data;
+    uint64_t size;
+    MessageBuffer data;
     
     Message() : type(MessageType::HELLO), size(0) {}
-    Message(MessageType t, const std::vector<uint8_t>& d) : type(t), size(d.size()), data(d) {}
+    Message(MessageType t, const std::vector<uint8_t>& d) : type(t), size(d.size()), data(d.begin(), d.end()) {}
 };
 
 // Utility functions
@@ -2,18 +2,338 @@
 #include <iomanip>
 #include <sstream>
 #include <cstring>
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
 
-bool CryptoUtils::openssl_initialized = false;
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define GC_HAVE_X86_AES 1
+#endif
+
+std::atomic<bool> CryptoUtils::openssl_initialized{false};
+std::mutex CryptoUtils::init_mutex;
+AesBackend CryptoUtils::active_backend = AesBackend::EVP;
+
+namespace {
+
+// Public key of the fixed-key AES permutation; garbler and evaluator must agree on it
+const uint8_t FIXED_AES_KEY[16] = {
+    0x24, 0x3f, 0x6a, 0x88, 0x85, 0xa3, 0x08, 0xd3,
+    0x13, 0x19, 0x8a, 0x2e, 0x03, 0x70, 0x73, 0x44
+};
+
+// A label as two big-endian 64-bit words (byte 0 is the most significant)
+struct BigEndianWords {
+    uint64_t hi;
+    uint64_t lo;
+};
+
+BigEndianWords load_be_words(const WireLabel& in) {
+    BigEndianWords w;
+    std::memcpy(&w.hi, in.data(), 8);
+    std::memcpy(&w.lo, in.data() + 8, 8);
+    w.hi = __builtin_bswap64(w.hi);
+    w.lo = __builtin_bswap64(w.lo);
+    return w;
+}
+
+WireLabel store_be_words(BigEndianWords w) {
+    WireLabel out;
+    w.hi = __builtin_bswap64(w.hi);
+    w.lo = __builtin_bswap64(w.lo);
+    std::memcpy(out.data(), &w.hi, 8);
+    std::memcpy(out.data() + 8, &w.lo, 8);
+    return out;
+}
+
+// Multiply a 128-bit block by x in GF(2^128) (byte 0 is the most significant)
+BigEndianWords gf128_double(BigEndianWords in) {
+    uint64_t carry = in.hi >> 63;
+    return {(in.hi << 1) | (in.lo >> 63), (in.lo << 1) ^ (0x87 & (0 - carry))};
+}
+
+// PRF input block K = 2*key1 ^ 4*key2 ^ tweak, tweak in big-endian format
+WireLabel tweaked_key(const WireLabel& key1, const WireLabel& key2, uint64_t tweak) {
+    BigEndianWords k1 = gf128_double(load_be_words(key1));
+    BigEndianWords k2 = gf128_double(gf128_double(load_be_words(key2)));
+    return store_be_words({k1.hi ^ k2.hi, k1.lo ^ k2.lo ^ tweak});
+}
+
+// Blocks hashed per backend call in PRF_batch
+constexpr size_t PRF_BATCH_CHUNK = 64;
+
+#ifdef GC_HAVE_X86_AES
+
+constexpr int AES128_ROUNDS = 10;
+
+// Round keys of the fixed-key permutation, expanded once in init_openssl()
+alignas(16) __m128i fixed_round_keys[AES128_ROUNDS + 1];
+
+template <int RCON>
+__attribute__((target("aes,sse2")))
+inline __m128i aesni_expand_step(__m128i key) {
+    __m128i gen = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(key, RCON), 0xff);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, gen);
+}
+
+__attribute__((target("aes,sse2")))
+void aesni_expand_key(const uint8_t* key, __m128i* rk) {
+    rk[0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key));
+    rk[1] = aesni_expand_step<0x01>(rk[0]);
+    rk[2] = aesni_expand_step<0x02>(rk[1]);
+    rk[3] = aesni_expand_step<0x04>(rk[2]);
+    rk[4] = aesni_expand_step<0x08>(rk[3]);
+    rk[5] = aesni_expand_step<0x10>(rk[4]);
+    rk[6] = aesni_expand_step<0x20>(rk[5]);
+    rk[7] = aesni_expand_step<0x40>(rk[6]);
+    rk[8] = aesni_expand_step<0x80>(rk[7]);
+    rk[9] = aesni_expand_step<0x1b>(rk[8]);
+    rk[10] = aesni_expand_step<0x36>(rk[9]);
+}
+
+// Equivalent inverse cipher schedule for AESDEC
+__attribute__((target("aes,sse2")))
+void aesni_invert_key(const __m128i* rk, __m128i* dk) {
+    dk[0] = rk[AES128_ROUNDS];
+    for (int i = 1; i < AES128_ROUNDS; ++i) {
+        dk[i] = _mm_aesimc_si128(rk[AES128_ROUNDS - i]);
+    }
+    dk[AES128_ROUNDS] = rk[0];
+}
+
+// ECB encryption in place; four independent blocks keep the AES unit pipelined
+__attribute__((target("aes,sse2")))
+void aesni_encrypt_blocks(const __m128i* rk, uint8_t* blocks, size_t n) {
+    __m128i* p = reinterpret_cast<__m128i*>(blocks);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i b0 = _mm_xor_si128(_mm_loadu_si128(p + i), rk[0]);
+        __m128i b1 = _mm_xor_si128(_mm_loadu_si128(p + i + 1), rk[0]);
+        __m128i b2 = _mm_xor_si128(_mm_loadu_si128(p + i + 2), rk[0]);
+        __m128i b3 = _mm_xor_si128(_mm_loadu_si128(p + i + 3), rk[0]);
+        for (int r = 1; r < AES128_ROUNDS; ++r) {
+            b0 = _mm_aesenc_si128(b0, rk[r]);
+            b1 = _mm_aesenc_si128(b1, rk[r]);
+            b2 = _mm_aesenc_si128(b2, rk[r]);
+            b3 = _mm_aesenc_si128(b3, rk[r]);
+        }
+        _mm_storeu_si128(p + i, _mm_aesenclast_si128(b0, rk[AES128_ROUNDS]));
+        _mm_storeu_si128(p + i + 1, _mm_aesenclast_si128(b1, rk[AES128_ROUNDS]));
+        _mm_storeu_si128(p + i + 2, _mm_aesenclast_si128(b2, rk[AES128_ROUNDS]));
+        _mm_storeu_si128(p + i + 3, _mm_aesenclast_si128(b3, rk[AES128_ROUNDS]));
+    }
+    for (; i < n; ++i) {
+        __m128i b = _mm_xor_si128(_mm_loadu_si128(p + i), rk[0]);
+        for (int r = 1; r < AES128_ROUNDS; ++r) {
+            b = _mm_aesenc_si128(b, rk[r]);
+        }
+        _mm_storeu_si128(p + i, _mm_aesenclast_si128(b, rk[AES128_ROUNDS]));
+    }
+}
+
+__attribute__((target("aes,sse2")))
+void aesni_decrypt_blocks(const __m128i* dk, uint8_t* blocks, size_t n) {
+    __m128i* p = reinterpret_cast<__m128i*>(blocks);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i b0 = _mm_xor_si128(_mm_loadu_si128(p + i), dk[0]);
+        __m128i b1 = _mm_xor_si128(_mm_loadu_si128(p + i + 1), dk[0]);
+        __m128i b2 = _mm_xor_si128(_mm_loadu_si128(p + i + 2), dk[0]);
+        __m128i b3 = _mm_xor_si128(_mm_loadu_si128(p + i + 3), dk[0]);
+        for (int r = 1; r < AES128_ROUNDS; ++r) {
+            b0 = _mm_aesdec_si128(b0, dk[r]);
+            b1 = _mm_aesdec_si128(b1, dk[r]);
+            b2 = _mm_aesdec_si128(b2, dk[r]);
+            b3 = _mm_aesdec_si128(b3, dk[r]);
+        }
+        _mm_storeu_si128(p + i, _mm_aesdeclast_si128(b0, dk[AES128_ROUNDS]));
+        _mm_storeu_si128(p + i + 1, _mm_aesdeclast_si128(b1, dk[AES128_ROUNDS]));
+        _mm_storeu_si128(p + i + 2, _mm_aesdeclast_si128(b2, dk[AES128_ROUNDS]));
+        _mm_storeu_si128(p + i + 3, _mm_aesdeclast_si128(b3, dk[AES128_ROUNDS]));
+    }
+    for (; i < n; ++i) {
+        __m128i b = _mm_xor_si128(_mm_loadu_si128(p + i), dk[0]);
+        for (int r = 1; r < AES128_ROUNDS; ++r) {
+            b = _mm_aesdec_si128(b, dk[r]);
+        }
+        _mm_storeu_si128(p + i, _mm_aesdeclast_si128(b, dk[AES128_ROUNDS]));
+    }
+}
+
+// ECB encryption in place with 512-bit VAES: each instruction covers four
+// blocks and four registers are kept in flight, the remainder goes to AES-NI
+__attribute__((target("aes,avx512f,vaes")))
+void vaes_encrypt_blocks(const __m128i* rk, uint8_t* blocks, size_t n) {
+    __m512i k[AES128_ROUNDS + 1];
+    for (int r = 0; r <= AES128_ROUNDS; ++r) {
+        k[r] = _mm512_maskz_broadcast_i32x4(0xffff, rk[r]);
+    }
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8_t* p = blocks + i * 16;
+        __m512i b0 = _mm512_xor_si512(_mm512_loadu_si512(p), k[0]);
+        __m512i b1 = _mm512_xor_si512(_mm512_loadu_si512(p + 64), k[0]);
+        __m512i b2 = _mm512_xor_si512(_mm512_loadu_si512(p + 128), k[0]);
+        __m512i b3 = _mm512_xor_si512(_mm512_loadu_si512(p + 192), k[0]);
+        for (int r = 1; r < AES128_ROUNDS; ++r) {
+            b0 = _mm512_aesenc_epi128(b0, k[r]);
+            b1 = _mm512_aesenc_epi128(b1, k[r]);
+            b2 = _mm512_aesenc_epi128(b2, k[r]);
+            b3 = _mm512_aesenc_epi128(b3, k[r]);
+        }
+        _mm512_storeu_si512(p, _mm512_aesenclast_epi128(b0, k[AES128_ROUNDS]));
+        _mm512_storeu_si512(p + 64, _mm512_aesenclast_epi128(b1, k[AES128_ROUNDS]));
+        _mm512_storeu_si512(p + 128, _mm512_aesenclast_epi128(b2, k[AES128_ROUNDS]));
+        _mm512_storeu_si512(p + 192, _mm512_aesenclast_epi128(b3, k[AES128_ROUNDS]));
+    }
+    for (; i + 4 <= n; i += 4) {
+        uint8_t* p = blocks + i * 16;
+        __m512i b = _mm512_xor_si512(_mm512_loadu_si512(p), k[0]);
+        for (int r = 1; r < AES128_ROUNDS; ++r) {
+            b = _mm512_aesenc_epi128(b, k[r]);
+        }
+        _mm512_storeu_si512(p, _mm512_aesenclast_epi128(b, k[AES128_ROUNDS]));
+    }
+    if (i < n) {
+        aesni_encrypt_blocks(rk, blocks + i * 16, n - i);
+    }
+}
+
+#endif // GC_HAVE_X86_AES
+
+AesBackend detect_aes_backend() {
+    // GC_AES_BACKEND=evp|aesni|vaes overrides the CPUID choice
+    if (const char* env = std::getenv("GC_AES_BACKEND")) {
+        std::string name(env);
+        if (name == "evp") return AesBackend::EVP;
+        if (name == "aesni") return AesBackend::AESNI;
+        if (name == "vaes") return AesBackend::VAES;
+        throw CryptoException("Unknown GC_AES_BACKEND: " + name);
+    }
+    if (CryptoUtils::aes_backend_supported(AesBackend::VAES)) return AesBackend::VAES;
+    if (CryptoUtils::aes_backend_supported(AesBackend::AESNI)) return AesBackend::AESNI;
+    return AesBackend::EVP;
+}
+
+struct CipherCtxDeleter {
+    void operator()(EVP_CIPHER_CTX* ctx) const { EVP_CIPHER_CTX_free(ctx); }
+};
+
+// Per-thread EVP context reused across calls instead of allocated per call
+EVP_CIPHER_CTX* thread_cipher_ctx() {
+    thread_local std::unique_ptr<EVP_CIPHER_CTX, CipherCtxDeleter> ctx(EVP_CIPHER_CTX_new());
+    if (!ctx) {
+        throw CryptoException("Failed to create cipher context");
+    }
+    return ctx.get();
+}
+
+// Per-thread EVP context holding the fixed-key AES key schedule (EVP backend)
+EVP_CIPHER_CTX* thread_fixed_key_ctx() {
+    thread_local std::unique_ptr<EVP_CIPHER_CTX, CipherCtxDeleter> ctx;
+    if (!ctx) {
+        std::unique_ptr<EVP_CIPHER_CTX, CipherCtxDeleter> fresh(EVP_CIPHER_CTX_new());
+        if (!fresh || EVP_EncryptInit_ex(fresh.get(), EVP_aes_128_ecb(), NULL, FIXED_AES_KEY, NULL) != 1) {
+            throw CryptoException("Failed to initialize fixed-key AES");
+        }
+        EVP_CIPHER_CTX_set_padding(fresh.get(), 0);
+        ctx = std::move(fresh);
+    }
+    return ctx.get();
+}
+
+} // namespace
 
 void CryptoUtils::init_openssl() {
-    if (!openssl_initialized) {
-        openssl_initialized = true;
+    if (openssl_initialized.load(std::memory_order_acquire)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(init_mutex);
+    if (!openssl_initialized.load(std::memory_order_relaxed)) {
+        // Fail early if the fixed-key schedule cannot be set up
+        thread_fixed_key_ctx();
+#ifdef GC_HAVE_X86_AES
+        if (aes_backend_supported(AesBackend::AESNI)) {
+            aesni_expand_key(FIXED_AES_KEY, fixed_round_keys);
+        }
+#endif
+        AesBackend backend = detect_aes_backend();
+        if (!aes_backend_supported(backend)) {
+            throw CryptoException(std::string("AES backend not supported by this CPU: ") +
+                                  aes_backend_name(backend));
+        }
+        active_backend = backend;
+        openssl_initialized.store(true, std::memory_order_release);
     }
 }
 
 void CryptoUtils::cleanup_openssl() {
-    if (openssl_initialized) {
-        openssl_initialized = false;
+    std::lock_guard<std::mutex> lock(init_mutex);
+    openssl_initialized.store(false, std::memory_order_release);
+}
+
+AesBackend CryptoUtils::aes_backend() {
+    init_openssl();
+    return active_backend;
+}
+
+void CryptoUtils::set_aes_backend(AesBackend backend) {
+    init_openssl();
+    if (!aes_backend_supported(backend)) {
+        throw CryptoException(std::string("AES backend not supported by this CPU: ") +
+                              aes_backend_name(backend));
+    }
+    active_backend = backend;
+}
+
+bool CryptoUtils::aes_backend_supported(AesBackend backend) {
+    switch (backend) {
+        case AesBackend::EVP:
+            return true;
+#ifdef GC_HAVE_X86_AES
+        case AesBackend::AESNI:
+            return __builtin_cpu_supports("aes") && __builtin_cpu_supports("sse2");
+        case AesBackend::VAES:
+            // The 4-block tail falls back to AES-NI
+            return __builtin_cpu_supports("vaes") && __builtin_cpu_supports("avx512f") &&
+                   __builtin_cpu_supports("aes");
+#endif
+        default:
+            return false;
+    }
+}
+
+const char* CryptoUtils::aes_backend_name(AesBackend backend) {
+    switch (backend) {
+        case AesBackend::EVP: return "EVP";
+        case AesBackend::AESNI: return "AES-NI";
+        case AesBackend::VAES: return "VAES";
+    }
+    return "UNKNOWN";
+}
+
+void CryptoUtils::fixed_key_encrypt_blocks(uint8_t* blocks, size_t n) {
+    switch (active_backend) {
+#ifdef GC_HAVE_X86_AES
+        case AesBackend::VAES:
+            vaes_encrypt_blocks(fixed_round_keys, blocks, n);
+            return;
+        case AesBackend::AESNI:
+            aesni_encrypt_blocks(fixed_round_keys, blocks, n);
+            return;
+#endif
+        default: {
+            int len = 0;
+            int total = static_cast<int>(n * AES_BLOCK_SIZE);
+            if (EVP_EncryptUpdate(thread_fixed_key_ctx(), blocks, &len, blocks, total) != 1 || len != total) {
+                throw CryptoException("Fixed-key AES evaluation failed");
+            }
+            return;
+        }
     }
 }
 
@@ -38,67 +358,210 @@ std::vector<WireLabel> CryptoUtils::generate_random_labels(size_t count) {
     return labels;
 }
 
-std::vector<uint8_t> CryptoUtils::PRF(const WireLabel& key1, const WireLabel& key2, uint32_t gate_id) {
+WireLabel CryptoUtils::PRF(const WireLabel& key1, const WireLabel& key2, uint64_t tweak) {
     init_openssl();
     
-    // Combine keys and gate_id for PRF input
-    std::vector<uint8_t> input;
-    input.insert(input.end(), key1.begin(), key1.end());
-    input.insert(input.end(), key2.begin(), key2.end());
+    WireLabel k = tweaked_key(key1, key2, tweak);
     
-    // Add gate_id in big-endian format
-    input.push_back((gate_id >> 24) & 0xFF);
-    input.push_back((gate_id >> 16) & 0xFF);
-    input.push_back((gate_id >> 8) & 0xFF);
-    input.push_back(gate_id & 0xFF);
+    // H = pi(K) ^ K under the fixed key
+    WireLabel out = k;
+    fixed_key_encrypt_blocks(out.data(), 1);
+    return out ^ k;
+}
+
+void CryptoUtils::PRF_batch(const HashQuery* queries, WireLabel* out, size_t n) {
+    init_openssl();
     
-    // Use SHA-256 as PRF
-    return sha256(input);
+    WireLabel k[PRF_BATCH_CHUNK];
+    for (size_t start = 0; start < n; start += PRF_BATCH_CHUNK) {
+        size_t m = std::min(PRF_BATCH_CHUNK, n - start);
+        for (size_t i = 0; i < m; ++i) {
+            const HashQuery& q = queries[start + i];
+            k[i] = tweaked_key(q.key1, q.key2, q.tweak);
+            out[start + i] = k[i];
+        }
+        fixed_key_encrypt_blocks(out[start].data(), m);
+        for (size_t i = 0; i < m; ++i) {
+            out[start + i] ^= k[i];
+        }
+    }
+}
+
+std::vector<WireLabel> CryptoUtils::PRF_batch(const std::vector<HashQuery>& queries) {
+    std::vector<WireLabel> out(queries.size());
+    PRF_batch(queries.data(), out.data(), queries.size());
+    return out;
 }
 
 std::vector<uint8_t> CryptoUtils::encrypt_label(const WireLabel& output_label,
                                               const WireLabel& key1,
                                               const WireLabel& key2,
                                               uint32_t gate_id) {
-    // Create plaintext: output_label + padding for verification
-    std::vector<uint8_t> plaintext;
-    plaintext.insert(plaintext.end(), output_label.begin(), output_label.end());
-    
-    // Add padding (16 zero bytes for verification)
-    plaintext.insert(plaintext.end(), 16, 0x00);
-    
-    // Generate encryption key from PRF
-    auto prf_output = PRF(key1, key2, gate_id);
-    std::vector<uint8_t> enc_key(prf_output.begin(), prf_output.begin() + WIRE_LABEL_SIZE);
-    
-    // Encrypt using AES
-    auto ciphertext = aes_encrypt(plaintext, enc_key);
+    // Generate encryption key from PRF (gate_id is the hash tweak)
+    return encrypt_label(output_label, PRF(key1, key2, gate_id));
+}
+
+std::vector<uint8_t> CryptoUtils::encrypt_label(const WireLabel& output_label, const WireLabel& prf_output) {
+    std::vector<uint8_t> ciphertext(WIRE_LABEL_SIZE + 16);
+    encrypt_label(ciphertext.data(), output_label, prf_output);
     return ciphertext;
 }
 
+void CryptoUtils::encrypt_label(uint8_t* row_out, const WireLabel& output_label, const WireLabel& prf_output) {
+    // Plaintext: output_label + 16 zero bytes of padding for verification
+    std::memcpy(row_out, output_label.data(), WIRE_LABEL_SIZE);
+    std::memset(row_out + WIRE_LABEL_SIZE, 0, 16);
+    if (!aes_encrypt_blocks(row_out, 2, prf_output)) {
+        throw CryptoException("Failed to encrypt data");
+    }
+}
+
 WireLabel CryptoUtils::decrypt_label(const std::vector<uint8_t>& ciphertext,
                                    const WireLabel& key1,
                                    const WireLabel& key2,
                                    uint32_t gate_id) {
-    // Generate decryption key from PRF
-    auto prf_output = PRF(key1, key2, gate_id);
-    std::vector<uint8_t> dec_key(prf_output.begin(), prf_output.begin() + WIRE_LABEL_SIZE);
-    
-    // Decrypt using AES
-    auto plaintext = aes_decrypt(ciphertext, dec_key);
-    // Correct decryption: label + 16 zero bytes padding 
-    if (plaintext.size() < WIRE_LABEL_SIZE + 16) {
-        throw CryptoException("Decryption failed: insufficient data");
-    }
-    // Padding/integrity check: last 16 bytes must be zero (success message).
-    for (size_t i = WIRE_LABEL_SIZE; i < WIRE_LABEL_SIZE + 16; ++i) {
-        if (plaintext[i] != 0x00) {
+    // Generate decryption key from PRF (gate_id is the hash tweak)
+    return decrypt_label(ciphertext, PRF(key1, key2, gate_id));
+}
+
+WireLabel CryptoUtils::decrypt_label(const std::vector<uint8_t>& ciphertext, const WireLabel& prf_output) {
+    WireLabel label;
+    switch (try_decrypt_label(ciphertext, prf_output, label)) {
+        case DecryptStatus::SUCCESS:
+            return label;
+        case DecryptStatus::INVALID_LENGTH:
+            throw CryptoException("Decryption failed: insufficient data");
+        default:
             throw CryptoException("Decryption failed: invalid padding");
+    }
+}
+
+DecryptStatus CryptoUtils::try_decrypt_label(const std::vector<uint8_t>& ciphertext,
+                                           const WireLabel& prf_output,
+                                           WireLabel& label_out) {
+    if (ciphertext.size() != WIRE_LABEL_SIZE + 16) {
+        return DecryptStatus::INVALID_LENGTH;
+    }
+    return try_decrypt_rows(ciphertext.data(), 1, prf_output, label_out) == 0 ? DecryptStatus::SUCCESS
+                                                                               : DecryptStatus::INVALID_PADDING;
+}
+
+int CryptoUtils::try_decrypt_rows(const uint8_t* rows,
+                                  size_t n,
+                                  const WireLabel& prf_output,
+                                  WireLabel& label_out) {
+    constexpr size_t ROW_SIZE = WIRE_LABEL_SIZE + 16;
+    constexpr size_t MAX_ROWS = 4;
+    
+    for (size_t base = 0; base < n; base += MAX_ROWS) {
+        size_t m = std::min(MAX_ROWS, n - base);
+        
+        // Copy the rows (label block + padding block each) and decrypt them together
+        alignas(16) uint8_t buf[MAX_ROWS * ROW_SIZE];
+        std::memcpy(buf, rows + base * ROW_SIZE, m * ROW_SIZE);
+        if (!aes_decrypt_blocks(buf, 2 * m, prf_output)) {
+            return -1;
+        }
+        
+        // Padding check without early exit: OR all 16 padding bytes of each row
+        int hit = -1;
+        for (size_t r = m; r-- > 0;) {
+            uint8_t acc = 0;
+            for (size_t i = WIRE_LABEL_SIZE; i < ROW_SIZE; ++i) {
+                acc |= buf[r * ROW_SIZE + i];
+            }
+            hit = (acc == 0) ? static_cast<int>(r) : hit;
+        }
+        if (hit >= 0) {
+            std::memcpy(label_out.data(), buf + hit * ROW_SIZE, WIRE_LABEL_SIZE);
+            return static_cast<int>(base) + hit;
         }
     }
-    WireLabel label;
-    std::copy(plaintext.begin(), plaintext.begin() + WIRE_LABEL_SIZE, label.begin());
-    return label;
+    return -1;
+}
+
+bool CryptoUtils::aes_encrypt_blocks(uint8_t* blocks, size_t n, const WireLabel& key) {
+    init_openssl();
+    
+#ifdef GC_HAVE_X86_AES
+    if (active_backend != AesBackend::EVP) {
+        __m128i rk[AES128_ROUNDS + 1];
+        aesni_expand_key(key.data(), rk);
+        aesni_encrypt_blocks(rk, blocks, n);
+        return true;
+    }
+#endif
+    
+    EVP_CIPHER_CTX* ctx = thread_cipher_ctx();
+    int len = 0;
+    int total = static_cast<int>(n * AES_BLOCK_SIZE);
+    if (EVP_EncryptInit_ex(ctx, EVP_aes_128_ecb(), NULL, key.data(), NULL) != 1) {
+        return false;
+    }
+    EVP_CIPHER_CTX_set_padding(ctx, 0);
+    return EVP_EncryptUpdate(ctx, blocks, &len, blocks, total) == 1 && len == total;
+}
+
+bool CryptoUtils::aes_decrypt_blocks(uint8_t* blocks, size_t n, const WireLabel& key) {
+    init_openssl();
+    
+#ifdef GC_HAVE_X86_AES
+    if (active_backend != AesBackend::EVP) {
+        __m128i rk[AES128_ROUNDS + 1];
+        __m128i dk[AES128_ROUNDS + 1];
+        aesni_expand_key(key.data(), rk);
+        aesni_invert_key(rk, dk);
+        aesni_decrypt_blocks(dk, blocks, n);
+        return true;
+    }
+#endif
+    
+    EVP_CIPHER_CTX* ctx = thread_cipher_ctx();
+    int len = 0;
+    int total = static_cast<int>(n * AES_BLOCK_SIZE);
+    if (EVP_DecryptInit_ex(ctx, EVP_aes_128_ecb(), NULL, key.data(), NULL) != 1) {
+        return false;
+    }
+    EVP_CIPHER_CTX_set_padding(ctx, 0);
+    return EVP_DecryptUpdate(ctx, blocks, &len, blocks, total) == 1 && len == total;
+}
+
+std::vector<uint8_t> CryptoUtils::encrypt_label_otp(const WireLabel& output_label,
+                                                  const WireLabel& key1,
+                                                  const WireLabel& key2,
+                                                  uint32_t gate_id) {
+    return encrypt_label_otp(output_label, PRF(key1, key2, gate_id));
+}
+
+std::vector<uint8_t> CryptoUtils::encrypt_label_otp(const WireLabel& output_label, const WireLabel& pad) {
+    WireLabel row = output_label ^ pad;
+    return std::vector<uint8_t>(row.begin(), row.end());
+}
+
+WireLabel CryptoUtils::decrypt_label_otp(const std::vector<uint8_t>& ciphertext,
+                                       const WireLabel& key1,
+                                       const WireLabel& key2,
+                                       uint32_t gate_id) {
+    if (ciphertext.size() < WIRE_LABEL_SIZE) {
+        throw CryptoException("Decryption failed: insufficient data");
+    }
+    return decrypt_label_otp(ciphertext, PRF(key1, key2, gate_id));
+}
+
+WireLabel CryptoUtils::decrypt_label_otp(const std::vector<uint8_t>& ciphertext, const WireLabel& pad) {
+    if (ciphertext.size() < WIRE_LABEL_SIZE) {
+        throw CryptoException("Decryption failed: insufficient data");
+    }
+    return deserialize_label(ciphertext) ^ pad;
+}
+
+void CryptoUtils::encrypt_label_otp(uint8_t* row_out, const WireLabel& output_label, const WireLabel& pad) {
+    WireLabel row = output_label ^ pad;
+    std::memcpy(row_out, row.data(), WIRE_LABEL_SIZE);
+}
+
+WireLabel CryptoUtils::decrypt_label_otp(const uint8_t* row, const WireLabel& pad) {
+    return deserialize_label(row) ^ pad;
 }
 
 bool CryptoUtils::is_valid_decryption(const std::vector<uint8_t>& decrypted_data) {
@@ -116,18 +579,6 @@ bool CryptoUtils::is_valid_decryption(const std::vector<uint8_t>& decrypted_data
     return true;
 }
 
-WireLabel CryptoUtils::xor_labels(const WireLabel& a, const WireLabel& b) {
-    WireLabel result;
-    for (size_t i = 0; i < WIRE_LABEL_SIZE; ++i) {
-        result[i] = a[i] ^ b[i];
-    }
-    return result;
-}
-
-bool CryptoUtils::labels_equal(const WireLabel& a, const WireLabel& b) {
-    return std::equal(a.begin(), a.end(), b.begin());
-}
-
 std::string CryptoUtils::label_to_hex(const WireLabel& label) {
     std::stringstream ss;
     ss << std::hex << std::setfill('0');
@@ -195,18 +646,35 @@ WireLabel CryptoUtils::deserialize_label(const std::vector<uint8_t>& data, size_
     return label;
 }
 
+WireLabel CryptoUtils::deserialize_label(const uint8_t* data) {
+    WireLabel label;
+    std::memcpy(label.data(), data, WIRE_LABEL_SIZE);
+    return label;
+}
+
 std::vector<uint8_t> CryptoUtils::aes_encrypt(const std::vector<uint8_t>& plaintext,
                                             const std::vector<uint8_t>& key) {
     init_openssl();
     
-    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-    if (!ctx) {
-        throw CryptoException("Failed to create cipher context");
+    // Padding is disabled, so the input must be whole blocks
+    if (plaintext.size() % AES_BLOCK_SIZE != 0) {
+        throw CryptoException("Failed to encrypt data: length is not a multiple of the block size");
+    }
+    
+#ifdef GC_HAVE_X86_AES
+    if (active_backend != AesBackend::EVP) {
+        __m128i rk[AES128_ROUNDS + 1];
+        aesni_expand_key(key.data(), rk);
+        std::vector<uint8_t> ciphertext(plaintext);
+        aesni_encrypt_blocks(rk, ciphertext.data(), ciphertext.size() / AES_BLOCK_SIZE);
+        return ciphertext;
     }
+#endif
+    
+    EVP_CIPHER_CTX* ctx = thread_cipher_ctx();
     
     // Initialize encryption
     if (EVP_EncryptInit_ex(ctx, EVP_aes_128_ecb(), NULL, key.data(), NULL) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
         throw CryptoException("Failed to initialize encryption");
     }
     
@@ -218,17 +686,14 @@ std::vector<uint8_t> CryptoUtils::aes_encrypt(const std::vector<uint8_t>& plaint
     
     // Encrypt data
     if (EVP_EncryptUpdate(ctx, ciphertext.data(), &len1, plaintext.data(), plaintext.size()) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
         throw CryptoException("Failed to encrypt data");
     }
     
     // Finalize encryption
     if (EVP_EncryptFinal_ex(ctx, ciphertext.data() + len1, &len2) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
         throw CryptoException("Failed to finalize encryption");
     }
     
-    EVP_CIPHER_CTX_free(ctx);
     ciphertext.resize(len1 + len2);
     
     return ciphertext;
@@ -238,14 +703,26 @@ std::vector<uint8_t> CryptoUtils::aes_decrypt(const std::vector<uint8_t>& cipher
                                             const std::vector<uint8_t>& key) {
     init_openssl();
     
-    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-    if (!ctx) {
-        throw CryptoException("Failed to create cipher context");
+    if (ciphertext.size() % AES_BLOCK_SIZE != 0) {
+        throw CryptoException("Failed to decrypt data: length is not a multiple of the block size");
     }
     
+#ifdef GC_HAVE_X86_AES
+    if (active_backend != AesBackend::EVP) {
+        __m128i rk[AES128_ROUNDS + 1];
+        __m128i dk[AES128_ROUNDS + 1];
+        aesni_expand_key(key.data(), rk);
+        aesni_invert_key(rk, dk);
+        std::vector<uint8_t> plaintext(ciphertext);
+        aesni_decrypt_blocks(dk, plaintext.data(), plaintext.size() / AES_BLOCK_SIZE);
+        return plaintext;
+    }
+#endif
+    
+    EVP_CIPHER_CTX* ctx = thread_cipher_ctx();
+    
     // Initialize decryption
     if (EVP_DecryptInit_ex(ctx, EVP_aes_128_ecb(), NULL, key.data(), NULL) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
         throw CryptoException("Failed to initialize decryption");
     }
     
@@ -257,21 +734,136 @@ std::vector<uint8_t> CryptoUtils::aes_decrypt(const std::vector<uint8_t>& cipher
     
     // Decrypt data
     if (EVP_DecryptUpdate(ctx, plaintext.data(), &len1, ciphertext.data(), ciphertext.size()) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
         throw CryptoException("Failed to decrypt data");
     }
     
     // Finalize decryption
     if (EVP_DecryptFinal_ex(ctx, plaintext.data() + len1, &len2) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
         throw CryptoException("Failed to finalize decryption");
     }
     
-    EVP_CIPHER_CTX_free(ctx);
     plaintext.resize(len1 + len2);
     return plaintext;
 }
 
+// AesCtrPrg implementation
+AesCtrPrg::AesCtrPrg() : AesCtrPrg(CryptoUtils::generate_random_label()) {}
+
+AesCtrPrg::AesCtrPrg(const WireLabel& seed) {
+    reseed(seed);
+}
+
+AesCtrPrg::~AesCtrPrg() {
+    if (evp_ctx_) {
+        EVP_CIPHER_CTX_free(evp_ctx_);
+    }
+}
+
+void AesCtrPrg::reseed(const WireLabel& seed) {
+    backend_ = CryptoUtils::aes_backend();
+    counter_ = 0;
+    buffer_pos_ = sizeof(buffer_);
+    fill_blocks_ = BUFFER_BLOCKS;
+    
+#ifdef GC_HAVE_X86_AES
+    if (backend_ != AesBackend::EVP) {
+        aesni_expand_key(seed.data(), reinterpret_cast<__m128i*>(round_keys_));
+        return;
+    }
+#endif
+    
+    if (!evp_ctx_) {
+        evp_ctx_ = EVP_CIPHER_CTX_new();
+        if (!evp_ctx_) {
+            throw CryptoException("Failed to create PRG cipher context");
+        }
+    }
+    if (EVP_EncryptInit_ex(evp_ctx_, EVP_aes_128_ecb(), NULL, seed.data(), NULL) != 1) {
+        throw CryptoException("Failed to initialize PRG");
+    }
+    EVP_CIPHER_CTX_set_padding(evp_ctx_, 0);
+}
+
+void AesCtrPrg::seek(uint64_t block) {
+    counter_ = block;
+    buffer_pos_ = sizeof(buffer_);
+    fill_blocks_ = SEEK_FILL_BLOCKS;
+}
+
+void AesCtrPrg::refill() {
+    // Block i of the stream is AES_seed(i), the counter little-endian in the low 8 bytes.
+    // The blocks go at the end of the buffer, so a short fill is consumed the same way
+    size_t n = fill_blocks_;
+    uint8_t* blocks = buffer_ + sizeof(buffer_) - n * AES_BLOCK_SIZE;
+    std::memset(blocks, 0, n * AES_BLOCK_SIZE);
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t ctr = counter_++;
+        std::memcpy(blocks + i * AES_BLOCK_SIZE, &ctr, sizeof(ctr));
+    }
+    
+    switch (backend_) {
+#ifdef GC_HAVE_X86_AES
+        case AesBackend::VAES:
+            vaes_encrypt_blocks(reinterpret_cast<const __m128i*>(round_keys_), blocks, n);
+            break;
+        case AesBackend::AESNI:
+            aesni_encrypt_blocks(reinterpret_cast<const __m128i*>(round_keys_), blocks, n);
+            break;
+#endif
+        default: {
+            int len = 0;
+            int total = static_cast<int>(n * AES_BLOCK_SIZE);
+            if (EVP_EncryptUpdate(evp_ctx_, blocks, &len, blocks, total) != 1 || len != total) {
+                throw CryptoException("PRG block generation failed");
+            }
+            break;
+        }
+    }
+    buffer_pos_ = sizeof(buffer_) - n * AES_BLOCK_SIZE;
+    fill_blocks_ = BUFFER_BLOCKS;
+}
+
+void AesCtrPrg::random_bytes(uint8_t* out, size_t n) {
+    while (n > 0) {
+        if (buffer_pos_ == sizeof(buffer_)) {
+            refill();
+        }
+        size_t take = std::min(n, sizeof(buffer_) - buffer_pos_);
+        std::memcpy(out, buffer_ + buffer_pos_, take);
+        buffer_pos_ += take;
+        out += take;
+        n -= take;
+    }
+}
+
+WireLabel AesCtrPrg::random_label() {
+    WireLabel label;
+    random_bytes(label.data(), WIRE_LABEL_SIZE);
+    return label;
+}
+
+std::vector<WireLabel> AesCtrPrg::random_labels(size_t count) {
+    std::vector<WireLabel> labels(count);
+    if (count > 0) {
+        random_bytes(labels[0].data(), count * WIRE_LABEL_SIZE);
+    }
+    return labels;
+}
+
+uint64_t AesCtrPrg::random_u64() {
+    uint64_t v;
+    random_bytes(reinterpret_cast<uint8_t*>(&v), sizeof(v));
+    return v;
+}
+
+WireLabel AesCtrPrg::seed_from_u64(uint64_t value) {
+    WireLabel seed{};
+    for (size_t i = 0; i < 8; ++i) {
+        seed[WIRE_LABEL_SIZE - 1 - i] = static_cast<uint8_t>((value >> (8 * i)) & 0xFF);
+    }
+    return seed;
+}
+
 // OpenSSLContext implementation
 OpenSSLContext::OpenSSLContext() : initialized(false) {
     CryptoUtils::init_openssl();
@@ -5,6 +5,29 @@
 #include <openssl/aes.h>
 #include <openssl/rand.h>
 #include <openssl/evp.h>
+#include <atomic>
+#include <mutex>
+
+// AES-128 block-cipher backends, selected once at startup by CPUID
+enum class AesBackend {
+    EVP,    // OpenSSL EVP (portable fallback)
+    AESNI,  // AES-NI intrinsics, 4 blocks interleaved
+    VAES    // AVX-512 VAES, 4 blocks per instruction and up to 16 in flight
+};
+
+// Outcome of a non-throwing trial decryption
+enum class DecryptStatus {
+    SUCCESS,
+    INVALID_PADDING, // Wrong key: the 16 integrity bytes are not zero
+    INVALID_LENGTH   // Not a 32-byte label + padding row
+};
+
+// One tweakable hash query H(key1, key2, tweak) for CryptoUtils::PRF_batch
+struct HashQuery {
+    WireLabel key1;
+    WireLabel key2;
+    uint64_t tweak;
+};
 
 /**
  * Cryptographic utilities for garbled circuits
@@ -12,14 +35,21 @@
  */
 class CryptoUtils {
 public:
-    // Generate random wire label
+    // Generate random wire label straight from the OS (RAND_bytes); bulk garbling
+    // randomness comes from an AesCtrPrg seeded this way
     static WireLabel generate_random_label();
     
     // Generate multiple random labels
     static std::vector<WireLabel> generate_random_labels(size_t count);
     
-    // Pseudorandom function G(key1, key2, gate_id) -> output
-    static std::vector<uint8_t> PRF(const WireLabel& key1, const WireLabel& key2, uint32_t gate_id);
+    // Tweakable correlation-robust hash H(key1, key2, tweak) -> 128-bit output
+    // Fixed-key AES: H = pi(K) ^ K with K = 2*key1 ^ 4*key2 ^ tweak (gate id)
+    static WireLabel PRF(const WireLabel& key1, const WireLabel& key2, uint64_t tweak);
+    
+    // Batched PRF: out[i] = PRF(queries[i]). The fixed-key AES calls of the whole
+    // batch go through the backend together, keeping many blocks in flight
+    static void PRF_batch(const HashQuery* queries, WireLabel* out, size_t n);
+    static std::vector<WireLabel> PRF_batch(const std::vector<HashQuery>& queries);
     
     // Encrypt wire label using two input keys
     static std::vector<uint8_t> encrypt_label(const WireLabel& output_label, 
@@ -33,14 +63,54 @@ public:
                                  const WireLabel& key2,
                                  uint32_t gate_id);
     
+    // Same as above with a precomputed PRF(key1, key2, gate_id), e.g. from PRF_batch
+    static std::vector<uint8_t> encrypt_label(const WireLabel& output_label, const WireLabel& prf_output);
+    static WireLabel decrypt_label(const std::vector<uint8_t>& ciphertext, const WireLabel& prf_output);
+    
+    // Classic row written in place: WIRE_LABEL_SIZE + 16 bytes at row_out
+    static void encrypt_label(uint8_t* row_out, const WireLabel& output_label, const WireLabel& prf_output);
+    
+    // Non-throwing decrypt_label: on SUCCESS the label is written to label_out
+    static DecryptStatus try_decrypt_label(const std::vector<uint8_t>& ciphertext,
+                                         const WireLabel& prf_output,
+                                         WireLabel& label_out);
+    
+    // Trial-decrypt n contiguous classic rows (WIRE_LABEL_SIZE + 16 bytes each)
+    // under one key in a single batched AES pass with branch-free padding checks.
+    // Returns the index of the first row that decrypts correctly (label in
+    // label_out) or -1; never throws on a wrong row
+    static int try_decrypt_rows(const uint8_t* rows,
+                                size_t n,
+                                const WireLabel& prf_output,
+                                WireLabel& label_out);
+    
+    // Compact 16-byte row H(key1, key2, gate_id) ^ label, for point-and-permute
+    // tables where the evaluator knows which row to open and needs no padding check
+    static std::vector<uint8_t> encrypt_label_otp(const WireLabel& output_label,
+                                                const WireLabel& key1,
+                                                const WireLabel& key2,
+                                                uint32_t gate_id);
+    
+    static WireLabel decrypt_label_otp(const std::vector<uint8_t>& ciphertext,
+                                     const WireLabel& key1,
+                                     const WireLabel& key2,
+                                     uint32_t gate_id);
+    
+    static std::vector<uint8_t> encrypt_label_otp(const WireLabel& output_label, const WireLabel& pad);
+    static WireLabel decrypt_label_otp(const std::vector<uint8_t>& ciphertext, const WireLabel& pad);
+    
+    // In-place variants on WIRE_LABEL_SIZE-byte rows of a table arena
+    static void encrypt_label_otp(uint8_t* row_out, const WireLabel& output_label, const WireLabel& pad);
+    static WireLabel decrypt_label_otp(const uint8_t* row, const WireLabel& pad);
+    
     // Check if decryption was successful (padding verification)
     static bool is_valid_decryption(const std::vector<uint8_t>& decrypted_data);
     
     // XOR two wire labels
-    static WireLabel xor_labels(const WireLabel& a, const WireLabel& b);
+    static WireLabel xor_labels(const WireLabel& a, const WireLabel& b) { return a ^ b; }
     
     // Compare wire labels for equality
-    static bool labels_equal(const WireLabel& a, const WireLabel& b);
+    static bool labels_equal(const WireLabel& a, const WireLabel& b) { return a == b; }
     
     // Convert wire label to hex string (for printing)
     static std::string label_to_hex(const WireLabel& label);
@@ -56,6 +126,7 @@ public:
     
     // Deserialize bytes to wire label
     static WireLabel deserialize_label(const std::vector<uint8_t>& data, size_t offset = 0);
+    static WireLabel deserialize_label(const uint8_t* data);
     
     // Initialize OpenSSL (called automatically)
     static void init_openssl();
@@ -63,6 +134,13 @@ public:
     // Cleanup OpenSSL resources
     static void cleanup_openssl();
     
+    // Active AES backend; set_aes_backend() overrides the CPUID choice and
+    // throws CryptoException if the CPU lacks the instructions
+    static AesBackend aes_backend();
+    static void set_aes_backend(AesBackend backend);
+    static bool aes_backend_supported(AesBackend backend);
+    static const char* aes_backend_name(AesBackend backend);
+    
 private:
     
     // Internal encryption function
@@ -73,7 +151,66 @@ private:
     static std::vector<uint8_t> aes_decrypt(const std::vector<uint8_t>& ciphertext,
                                           const std::vector<uint8_t>& key);
     
-    static bool openssl_initialized;
+    // AES-128 encryption/decryption of n blocks in place under one key, no allocation
+    static bool aes_encrypt_blocks(uint8_t* blocks, size_t n, const WireLabel& key);
+    static bool aes_decrypt_blocks(uint8_t* blocks, size_t n, const WireLabel& key);
+    
+    // Fixed-key AES permutation pi applied in place to n 16-byte blocks
+    static void fixed_key_encrypt_blocks(uint8_t* blocks, size_t n);
+    
+    // Garbling and evaluation threads share these; init_openssl() is safe to
+    // call concurrently, the fixed-key EVP context is per thread
+    static std::atomic<bool> openssl_initialized;
+    static std::mutex init_mutex;
+    static AesBackend active_backend;
+};
+
+/**
+ * AES-128-CTR pseudorandom generator for garbling randomness (labels, delta,
+ * table permutations, filler rows). Seeded once, from the OS by default or
+ * from a fixed seed for reproducible runs; output is produced a buffer of
+ * blocks at a time through the active AES backend. Not thread-safe.
+ */
+class AesCtrPrg {
+public:
+    // Seed from the OS (RAND_bytes)
+    AesCtrPrg();
+    explicit AesCtrPrg(const WireLabel& seed);
+    ~AesCtrPrg();
+    
+    AesCtrPrg(const AesCtrPrg&) = delete;
+    AesCtrPrg& operator=(const AesCtrPrg&) = delete;
+    
+    // Restart the stream from a new seed
+    void reseed(const WireLabel& seed);
+    
+    // Continue the stream at block index `block` under the current seed, so
+    // independent parts of the work (e.g. one gate each) can draw from disjoint,
+    // reproducible substreams in any order
+    void seek(uint64_t block);
+    
+    void random_bytes(uint8_t* out, size_t n);
+    WireLabel random_label();
+    std::vector<WireLabel> random_labels(size_t count);
+    uint64_t random_u64();
+    
+    // Seed label holding a 64-bit value, for --seed style options
+    static WireLabel seed_from_u64(uint64_t value);
+    
+private:
+    static constexpr size_t BUFFER_BLOCKS = 64;
+    // First refill after a seek: substreams are usually short
+    static constexpr size_t SEEK_FILL_BLOCKS = 8;
+    
+    void refill();
+    
+    AesBackend backend_ = AesBackend::EVP;
+    alignas(16) uint8_t round_keys_[11 * AES_BLOCK_SIZE];
+    EVP_CIPHER_CTX* evp_ctx_ = nullptr;
+    uint64_t counter_ = 0;
+    alignas(16) uint8_t buffer_[BUFFER_BLOCKS * AES_BLOCK_SIZE];
+    size_t buffer_pos_ = sizeof(buffer_);
+    size_t fill_blocks_ = BUFFER_BLOCKS;
 };
 
 class OpenSSLContext {
@@ -24,6 +24,10 @@ public:
                 return 1;
             }
                         
+            if (io_uring) {
+                SocketUtils::set_transport(TransportBackend::IO_URING);
+            }
+            
             // Parse evaluator inputs
             auto evaluator_inputs = parse_inputs();
             
@@ -48,6 +52,10 @@ private:
     std::string input_string;
     int port;
     bool use_pandp = false;
+    bool use_free_xor = false;
+    GarblingScheme scheme = GarblingScheme::STANDARD;
+    size_t num_threads = 1;
+    bool io_uring = false;
     
     
     bool parse_arguments(int argc, char* argv[]) {
@@ -56,13 +64,18 @@ private:
             {"port", required_argument, 0, 'p'},
             {"input", required_argument, 0, 'i'},
             {"pandp", no_argument, 0, 0},
+            {"free-xor", no_argument, 0, 0},
+            {"half-gates", no_argument, 0, 0},
+            {"three-halves", no_argument, 0, 0},
+            {"threads", required_argument, 0, 't'},
+            {"io-uring", no_argument, 0, 0},
             {0, 0, 0, 0}
         };
         
         int opt;
         int option_index = 0;
         
-        while ((opt = getopt_long(argc, argv, "H:p:i:", long_options, &option_index)) != -1) {
+        while ((opt = getopt_long(argc, argv, "H:p:i:t:", long_options, &option_index)) != -1) {
             switch (opt) {
                 case 'H':
                     hostname = optarg;
@@ -73,9 +86,27 @@ private:
                 case 'i':
                     input_string = optarg;
                     break;
+                case 't':
+                    // 0 = one thread per hardware thread
+                    num_threads = std::stoul(optarg);
+                    break;
                 case 0:
                     if (std::string(long_options[option_index].name) == "pandp") {
                         use_pandp = true;
+                    } else if (std::string(long_options[option_index].name) == "free-xor") {
+                        use_free_xor = true;
+                    } else if (std::string(long_options[option_index].name) == "half-gates") {
+                        // Half-gates builds on free-XOR and point-and-permute
+                        scheme = GarblingScheme::HALF_GATES;
+                        use_pandp = true;
+                        use_free_xor = true;
+                    } else if (std::string(long_options[option_index].name) == "three-halves") {
+                        // Three-halves has the same requirements as half-gates
+                        scheme = GarblingScheme::THREE_HALVES;
+                        use_pandp = true;
+                        use_free_xor = true;
+                    } else if (std::string(long_options[option_index].name) == "io-uring") {
+                        io_uring = true;
                     }
                     break;
                 default:
@@ -126,7 +157,11 @@ private:
         std::cout << "\n[STEP 1] Receiving garbled circuit from garbler..." << std::endl;
         
     auto rc0 = std::chrono::high_resolution_clock::now();
-    auto garbled_circuit = protocol.receive_circuit();
+    // A streamed circuit's tables come after the inputs, and are evaluated as they arrive
+    auto garbled_circuit = protocol.receive_circuit_description();
+    if (!garbled_circuit.streamed) {
+        protocol.receive_tables(garbled_circuit);
+    }
     auto rc1 = std::chrono::high_resolution_clock::now();
     std::cout << "           Received circuit in "
           << std::chrono::duration_cast<std::chrono::milliseconds>(rc1 - rc0).count()
@@ -160,10 +195,26 @@ private:
     // Step 4: Evaluate the garbled circuit
     std::cout << "[STEP 4] Evaluating garbled circuit..." << std::endl;
     if (use_pandp) std::cout << "           Point-and-Permute: ENABLED" << std::endl;
+    if (use_free_xor) std::cout << "           Free-XOR: ENABLED" << std::endl;
+    if (scheme == GarblingScheme::HALF_GATES) std::cout << "           Half-Gates: ENABLED" << std::endl;
+    if (scheme == GarblingScheme::THREE_HALVES) std::cout << "           Three-Halves: ENABLED" << std::endl;
+    std::cout << "           AES backend: " << CryptoUtils::aes_backend_name(CryptoUtils::aes_backend()) << std::endl;
+    std::cout << "           Transport: " << SocketUtils::transport_name(SocketUtils::transport()) << std::endl;
         
-    Evaluator evaluator(use_pandp);
+    Evaluator evaluator(use_pandp, use_free_xor, scheme);
+    evaluator.set_threads(num_threads);
     auto ev0 = std::chrono::high_resolution_clock::now();
-    auto output_labels = evaluator.evaluate_circuit(garbled_circuit, all_input_labels);
+    std::vector<WireLabel> output_labels;
+    if (garbled_circuit.streamed) {
+        std::cout << "           Streaming: evaluating tables as they arrive" << std::endl;
+        output_labels = evaluator.evaluate_circuit_streaming(garbled_circuit, all_input_labels,
+                                                             STREAM_CHUNK_BYTES, STREAM_QUEUE_DEPTH,
+                                                             [&protocol](uint8_t* data, size_t size) {
+                                                                 protocol.receive_table_chunk(data, size);
+                                                             });
+    } else {
+        output_labels = evaluator.evaluate_circuit(garbled_circuit, all_input_labels);
+    }
     auto ev1 = std::chrono::high_resolution_clock::now();
     std::cout << "           Evaluation completed in "
           << std::chrono::duration_cast<std::chrono::milliseconds>(ev1 - ev0).count()
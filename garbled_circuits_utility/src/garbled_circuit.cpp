@@ -6,7 +6,57 @@
 #include <iomanip>
 #include <chrono>
 #include <set>
+#include <unordered_map>
 #include <sstream>
+#include <cstring>
+#include <climits>
+
+namespace {
+
+// Three-halves slices every label into 64-bit halves: L = bytes 0-7, R = bytes 8-15
+struct LabelHalves {
+    uint64_t l;
+    uint64_t r;
+};
+
+LabelHalves split_label(const WireLabel& label) {
+    LabelHalves h;
+    std::memcpy(&h.l, label.data(), 8);
+    std::memcpy(&h.r, label.data() + 8, 8);
+    return h;
+}
+
+WireLabel join_halves(uint64_t l, uint64_t r) {
+    WireLabel label;
+    std::memcpy(label.data(), &l, 8);
+    std::memcpy(label.data() + 8, &r, 8);
+    return label;
+}
+
+uint64_t load_half(const uint8_t* bytes) {
+    uint64_t v;
+    std::memcpy(&v, bytes, 8);
+    return v;
+}
+
+// Apply a 2-bit coefficient row to a label: bit 1 selects the L half, bit 0 the R half
+uint64_t select_halves(uint8_t coeff, const LabelHalves& x) {
+    return (coeff & 0x2 ? x.l : 0) ^ (coeff & 0x1 ? x.r : 0);
+}
+
+// phi(x, y) = (y, x ^ y) on coefficient rows; phi^2 + phi + 1 = 0
+uint8_t phi(uint8_t c) {
+    uint8_t x = (c >> 1) & 1;
+    uint8_t y = c & 1;
+    return static_cast<uint8_t>((y << 1) | (x ^ y));
+}
+
+// Per-row mask for the control bits, taken from hash bytes no other row can compute
+uint8_t control_mask(const WireLabel& ha, const WireLabel& hb, size_t row) {
+    return (ha[8 + row] ^ hb[8 + row]) & 0x3;
+}
+
+} // namespace
 
 GarbledCircuitManager::GarbledCircuitManager() {
 }
@@ -64,6 +114,9 @@ Circuit GarbledCircuitManager::parse_circuit(const std::string& circuit_descript
     if (!validate_circuit(circuit)) {
         throw std::runtime_error("Invalid circuit structure");
     }
+    
+    // Flat per-wire storage downstream relies on dense wire ids
+    CircuitUtils::renumber_wires(circuit);
 
     return circuit;
 }
@@ -316,186 +369,581 @@ Circuit GarbledCircuitManager::create_comparison_circuit(int bit_width) {
     circuit.output_wires = {carry_wire};
     circuit.num_gates = circuit.gates.size();
     circuit.num_wires = wire_counter - 1;
+    CircuitUtils::renumber_wires(circuit);
     
     return circuit;
 }
 
-Garbler::Garbler(bool use_pandp) : use_pandp_(use_pandp) {}
+Garbler::Garbler(bool use_pandp, bool use_free_xor, GarblingScheme scheme)
+    : use_pandp_(use_pandp), use_free_xor_(use_free_xor), scheme_(scheme),
+      pool_(std::make_unique<ThreadPool>(1)) {
+    if (scheme_ != GarblingScheme::STANDARD && !(use_pandp_ && use_free_xor_)) {
+        throw GarblerException("Half-gates and three-halves require free-XOR and point-and-permute");
+    }
+}
+
+GarbledCircuit Garbler::new_garbled_circuit(const Circuit& circuit) const {
+    if (!CircuitUtils::has_dense_wires(circuit)) {
+        throw GarblerException("Circuit wires are not densely numbered (see CircuitUtils::renumber_wires)");
+    }
+    
+    GarbledCircuit gc(circuit);
+    gc.point_and_permute = use_pandp_;
+    gc.free_xor = use_free_xor_;
+    gc.scheme = scheme_;
+    gc.compute_table_offsets();
+    return gc;
+}
 
 GarbledCircuit Garbler::garble_circuit(const Circuit& circuit) {
     LOG_INFO("Garbling circuit with " << circuit.num_gates << " gates");
     
-    GarbledCircuit gc(circuit);
+    GarbledCircuit gc = new_garbled_circuit(circuit);
+    gc.layout_tables();
     
-    // Generate random labels for all wires
-    generate_wire_labels(gc);
+    start_garbling(&gc, 1, CircuitUtils::topological_levels(gc));
+    uint8_t* window = gc.tables.data();
+    garble_levels(gc, 0, levels_.size(), &window, 0);
+    finish_garbling(&gc, 1);
     
-    // Garble each gate
-    for (size_t i = 0; i < circuit.gates.size(); ++i) {
-        gc.garbled_gates[i] = garble_gate(circuit.gates[i], i);
+    LOG_INFO("Circuit garbling completed");
+    return gc;
+}
+
+std::vector<GarbledCircuit> Garbler::garble_circuits(const Circuit& circuit, size_t count) {
+    LOG_INFO("Garbling " << count << " instances of a circuit with " << circuit.num_gates << " gates");
+    if (count == 0) {
+        return {};
     }
     
-    // Set up output mapping for decoding
-    for (int output_wire : circuit.output_wires) {
-        if (wire_labels.find(output_wire) != wire_labels.end()) {
-            // Store the "0" label for output decoding
-            gc.output_mapping[output_wire] = wire_labels[output_wire].first;
-        }
+    std::vector<GarbledCircuit> gcs(count, new_garbled_circuit(circuit));
+    std::vector<uint8_t*> windows;
+    for (auto& gc : gcs) {
+        gc.layout_tables();
+        windows.push_back(gc.tables.data());
     }
     
+    // One schedule and slot plan for all instances; each gets its own labels
+    start_garbling(gcs.data(), count, CircuitUtils::topological_levels(gcs[0]));
+    garble_levels(gcs[0], 0, levels_.size(), windows.data(), 0);
+    finish_garbling(gcs.data(), count);
+    
     LOG_INFO("Circuit garbling completed");
+    return gcs;
+}
+
+GarbledCircuit Garbler::begin_streaming(const Circuit& circuit, size_t chunk_bytes) {
+    GarbledCircuit gc = new_garbled_circuit(circuit);
+    gc.streamed = true;
+    
+    // A chunk only reads wires of earlier chunks, so each one can be garbled and
+    // sent before the next one starts
+    stream_chunk_ends_ = CircuitUtils::stream_chunk_ends(gc, chunk_bytes);
+    start_garbling(&gc, 1, CircuitUtils::topological_levels(gc, stream_chunk_ends_));
     return gc;
 }
 
-void Garbler::generate_wire_labels(GarbledCircuit& gc) {
-    wire_labels.clear();
+void Garbler::garble_circuit_streaming(GarbledCircuit& gc, size_t queue_depth,
+                                       const std::function<void(const uint8_t*, size_t)>& send_chunk) {
+    const auto& chunk_ends = stream_chunk_ends_;
+    LOG_INFO("Garbling circuit with " << gc.circuit.num_gates << " gates, streaming "
+             << gc.table_bytes() << " bytes of tables in " << chunk_ends.size() << " chunks");
+    
+    // The sender thread drains finished chunks while the next ones are garbled.
+    // At most queue_depth chunks wait; sent buffers come back for reuse, so no
+    // more than queue_depth + 2 chunk buffers ever exist
+    BoundedQueue<TableBuffer> ready(queue_depth);
+    BoundedQueue<TableBuffer> spare(queue_depth + 2);
+    std::exception_ptr send_error;
+    std::thread sender([&] {
+        try {
+            TableBuffer chunk;
+            while (ready.pop(chunk)) {
+                send_chunk(chunk.data(), chunk.size());
+                spare.push(std::move(chunk));
+            }
+        } catch (...) {
+            send_error = std::current_exception();
+            ready.close();
+        }
+    });
+    
+    try {
+        size_t level = 0;
+        size_t begin = 0;
+        for (size_t end : chunk_ends) {
+            size_t level_end = CircuitUtils::chunk_levels_end(levels_, level, end);
+            TableBuffer chunk;
+            spare.try_pop(chunk);
+            size_t window_start = gc.table_offsets[begin];
+            chunk.resize(gc.table_offsets[end] - window_start);
+            uint8_t* window = chunk.data();
+            garble_levels(gc, level, level_end, &window, window_start);
+            level = level_end;
+            begin = end;
+            
+            // A closed queue means the sender failed; its error is rethrown below
+            if (!chunk.empty() && !ready.push(std::move(chunk))) {
+                break;
+            }
+        }
+    } catch (...) {
+        ready.close();
+        sender.join();
+        throw;
+    }
+    ready.close();
+    sender.join();
+    if (send_error) {
+        std::rethrow_exception(send_error);
+    }
     
-    // Generate labels for input wires
-    for (int wire : gc.circuit.input_wires) {
-        WireLabel l0 = CryptoUtils::generate_random_label();
-        WireLabel l1 = CryptoUtils::generate_random_label();
-        if (use_pandp_) {
-            // Set permutation/color bit as LSB of last byte: 0 for label0, 1 for label1
-            l0[WIRE_LABEL_SIZE - 1] &= 0xFE;
-            l1[WIRE_LABEL_SIZE - 1] |= 0x01;
+    finish_garbling(&gc, 1);
+    LOG_INFO("Circuit garbling completed");
+}
+
+void Garbler::start_garbling(GarbledCircuit* gcs, size_t count, std::vector<std::vector<size_t>> levels) {
+    // Labels live in slots that are reused once their wire is dead. The table
+    // gates heading each level only read earlier levels and run in parallel
+    levels_ = std::move(levels);
+    level_table_gates_ = CircuitUtils::table_gate_counts(gcs[0], levels_);
+    slots_ = CircuitUtils::assign_wire_slots(gcs[0].circuit, levels_, level_table_gates_);
+    
+    // Gate randomness comes from a per-gate substream of one seed per instance, so
+    // the tables do not depend on the thread count or on which thread garbled
+    // which gate. Each instance draws its delta, input labels and gate seed in
+    // turn, as it would when garbled on its own
+    instances_.assign(count, {});
+    std::vector<WireLabel> gate_seeds(count);
+    for (size_t k = 0; k < count; ++k) {
+        generate_wire_labels(gcs[k], instances_[k]);
+        gate_seeds[k] = prg_.random_label();
+    }
+    
+    workers_.clear();
+    for (size_t w = 0; w < pool_->size(); ++w) {
+        auto worker = std::make_unique<GarbleWorker>();
+        for (const auto& seed : gate_seeds) {
+            worker->prgs.push_back(std::make_unique<AesCtrPrg>(seed));
+        }
+        workers_.push_back(std::move(worker));
+    }
+}
+
+void Garbler::garble_levels(const GarbledCircuit& gc, size_t first, size_t last,
+                            uint8_t* const* windows, size_t window_start) {
+    // Garble level by level: the workers take windows of up to GATE_BATCH_SIZE
+    // independent gate instances, then the caller garbles the level's free gates in order
+    size_t grain = std::max<size_t>(1, GATE_BATCH_SIZE / instances_.size());
+    for (size_t l = first; l < last; ++l) {
+        const auto& level = levels_[l];
+        size_t parallel = level_table_gates_[l];
+        pool_->parallel_for(parallel, grain, [&](size_t begin, size_t end, size_t w) {
+            garble_gates(gc, level.data() + begin, end - begin, *workers_[w], windows, window_start);
+        });
+        garble_gates(gc, level.data() + parallel, level.size() - parallel, *workers_[0], windows, window_start);
+    }
+}
+
+void Garbler::finish_garbling(GarbledCircuit* gcs, size_t count) {
+    // Set up output mapping for decoding: store the "0" label of each output wire
+    for (size_t k = 0; k < count; ++k) {
+        auto& gc = gcs[k];
+        gc.output_mapping.clear();
+        gc.output_mapping.reserve(gc.circuit.output_wires.size());
+        for (int slot : slots_.output_slots) {
+            gc.output_mapping.push_back(instances_[k].wire_labels[slot].first);
         }
-        wire_labels[wire] = {l0, l1};
     }
     
-    // Generate labels for internal and output wires
-    for (const auto& gate : gc.circuit.gates) {
-        if (wire_labels.find(gate.output_wire) == wire_labels.end()) {
-            WireLabel l0 = CryptoUtils::generate_random_label();
-            WireLabel l1 = CryptoUtils::generate_random_label();
-            if (use_pandp_) {
-                l0[WIRE_LABEL_SIZE - 1] &= 0xFE;
-                l1[WIRE_LABEL_SIZE - 1] |= 0x01;
+    LOG_INFO("Garbled with " << slots_.num_slots << " label slots for " << gcs[0].circuit.num_wires << " wires");
+}
+
+void Garbler::garble_gates(const GarbledCircuit& gc, const size_t* gates, size_t count, GarbleWorker& worker,
+                           uint8_t* const* windows, size_t window_start) {
+    // Lane-interleaved: the queries of all instances of a gate sit next to each
+    // other, and a batch holds about GATE_BATCH_SIZE gate instances
+    size_t lanes = instances_.size();
+    size_t batch = std::max<size_t>(1, GATE_BATCH_SIZE / lanes);
+    for (size_t start = 0; start < count; start += batch) {
+        size_t end = std::min(count, start + batch);
+        worker.queries.clear();
+        worker.offsets.clear();
+        for (size_t k = start; k < end; ++k) {
+            const Gate& gate = slots_.gates[gates[k]];
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                worker.offsets.push_back(worker.queries.size());
+                gate_hash_queries(gate, static_cast<int>(gates[k]), instances_[lane], worker.queries);
+            }
+        }
+        worker.hashes.resize(worker.queries.size());
+        CryptoUtils::PRF_batch(worker.queries.data(), worker.hashes.data(), worker.queries.size());
+        for (size_t k = start; k < end; ++k) {
+            size_t i = gates[k];
+            const Gate& gate = slots_.gates[i];
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                AesCtrPrg& prg = *worker.prgs[lane];
+                prg.seek(static_cast<uint64_t>(i) << 16);
+                garble_gate(gc.gate_table(i, windows[lane], window_start), gate,
+                            worker.hashes.data() + worker.offsets[(k - start) * lanes + lane],
+                            instances_[lane], prg);
             }
-            wire_labels[gate.output_wire] = {l0, l1};
         }
     }
+}
+
+void Garbler::generate_wire_labels(GarbledCircuit& gc) {
+    instances_.assign(1, {});
+    generate_wire_labels(gc, instances_[0]);
+}
+
+void Garbler::generate_wire_labels(GarbledCircuit& gc, GarbleInstance& instance) {
+    instance.wire_labels.assign(slots_.num_slots, {});
+    gc.input_labels.assign(gc.circuit.input_wires.size() + 1, {});
+    
+    if (use_free_xor_) {
+        instance.delta = prg_.random_label();
+        if (use_pandp_) {
+            // The two labels of a wire must carry opposite permutation bits
+            instance.delta[WIRE_LABEL_SIZE - 1] |= 0x01;
+        }
+    }
+    
+    // Generate labels for input wires and copy them to the garbled circuit (wire ids 1..num_inputs).
+    // Gate outputs get theirs while garbling: fresh for table gates (output_labels()), derived
+    // from the inputs for free-XOR, half-gates, three-halves and GRR3
+    for (size_t i = 0; i < gc.circuit.input_wires.size(); ++i) {
+        auto& labels = instance.wire_labels[slots_.input_slots[i]];
+        labels = make_label_pair(instance, prg_);
+        gc.input_labels[gc.circuit.input_wires[i]] = labels;
+    }
+    
+    LOG_INFO("Generated labels for " << gc.circuit.input_wires.size() << " input wires");
+}
+
+std::pair<WireLabel, WireLabel> Garbler::make_label_pair(const GarbleInstance& instance, AesCtrPrg& prg) {
+    WireLabel l0 = prg.random_label();
+    if (use_pandp_) {
+        // Set permutation/color bit as LSB of last byte: 0 for label0, 1 for label1
+        l0[WIRE_LABEL_SIZE - 1] &= 0xFE;
+    }
+    
+    if (use_free_xor_) {
+        return {l0, CryptoUtils::xor_labels(l0, instance.delta)};
+    }
+    
+    WireLabel l1 = prg.random_label();
+    if (use_pandp_) {
+        l1[WIRE_LABEL_SIZE - 1] |= 0x01;
+    }
+    return {l0, l1};
+}
+
+const std::pair<WireLabel, WireLabel>& Garbler::output_labels(const Gate& gate, GarbleInstance& instance, AesCtrPrg& prg) {
+    auto& labels = instance.wire_labels[gate.output_wire];
+    if (!use_pandp_ || gate.type == GateType::NOT) {
+        labels = make_label_pair(instance, prg);
+    }
+    return labels;
+}
+
+void Garbler::gate_hash_queries(const Gate& gate, int gate_id, const GarbleInstance& instance,
+                                std::vector<HashQuery>& queries) {
+    bool is_free = use_free_xor_ && (gate.type == GateType::XOR || gate.type == GateType::NOT);
+    if (is_free) {
+        return;
+    }
     
-    // Copy to garbled circuit
-    gc.input_labels = wire_labels;
+    const auto& in1_labels = instance.wire_labels[gate.input_wire1];
+    if (gate.type == GateType::NOT) {
+        // The two real rows; the dummy rows need no hash
+        queries.push_back({in1_labels.first, WireLabel{}, static_cast<uint64_t>(gate_id)});
+        queries.push_back({in1_labels.second, WireLabel{}, static_cast<uint64_t>(gate_id)});
+        return;
+    }
+    
+    const auto& in2_labels = instance.wire_labels[gate.input_wire2];
+    bool and_like = gate.type == GateType::AND || gate.type == GateType::OR || gate.type == GateType::NAND;
+    if (scheme_ == GarblingScheme::HALF_GATES && and_like) {
+        // H(A0), H(A1) under tweak 2g and H(B0), H(B1) under 2g+1, after the OR inversion
+        bool alpha = (gate.type == GateType::OR);
+        uint64_t tweak_g = 2 * static_cast<uint64_t>(gate_id);
+        queries.push_back({alpha ? in1_labels.second : in1_labels.first, WireLabel{}, tweak_g});
+        queries.push_back({alpha ? in1_labels.first : in1_labels.second, WireLabel{}, tweak_g});
+        queries.push_back({alpha ? in2_labels.second : in2_labels.first, WireLabel{}, tweak_g + 1});
+        queries.push_back({alpha ? in2_labels.first : in2_labels.second, WireLabel{}, tweak_g + 1});
+        return;
+    }
+    if (scheme_ == GarblingScheme::THREE_HALVES && and_like) {
+        // H(A_c), H(B_c), H(A_0 ^ B_c) for both perm-bit colors c, interleaved per color
+        WireLabel a_col[2] = {in1_labels.first, in1_labels.second};
+        WireLabel b_col[2] = {in2_labels.first, in2_labels.second};
+        if (perm_bit(a_col[0])) std::swap(a_col[0], a_col[1]);
+        if (perm_bit(b_col[0])) std::swap(b_col[0], b_col[1]);
+        uint64_t tweak = 3 * static_cast<uint64_t>(gate_id);
+        for (int c = 0; c < 2; ++c) {
+            queries.push_back({a_col[c], WireLabel{}, tweak});
+            queries.push_back({b_col[c], WireLabel{}, tweak + 1});
+            queries.push_back({CryptoUtils::xor_labels(a_col[0], b_col[c]), WireLabel{}, tweak + 2});
+        }
+        return;
+    }
     
-    LOG_INFO("Generated labels for " << wire_labels.size() << " wires");
+    // Garbled truth table: row (a, b) is keyed by H(in1 label a, in2 label b, gate_id)
+    const WireLabel* in1[2] = {&in1_labels.first, &in1_labels.second};
+    const WireLabel* in2[2] = {&in2_labels.first, &in2_labels.second};
+    for (int a = 0; a < 2; ++a) {
+        for (int b = 0; b < 2; ++b) {
+            queries.push_back({*in1[a], *in2[b], static_cast<uint64_t>(gate_id)});
+        }
+    }
 }
 
-GarbledGate Garbler::garble_gate(const Gate& gate, int gate_id) {
+void Garbler::garble_gate(GarbledGate table, const Gate& gate, const WireLabel* hashes,
+                          GarbleInstance& instance, AesCtrPrg& prg) {
+    if (scheme_ != GarblingScheme::STANDARD &&
+        (gate.type == GateType::AND || gate.type == GateType::OR || gate.type == GateType::NAND)) {
+        if (scheme_ == GarblingScheme::HALF_GATES) {
+            garble_half_gate(table, gate, hashes, instance);
+        } else {
+            garble_three_halves_gate(table, gate, hashes, instance, prg);
+        }
+        return;
+    }
+    
     switch (gate.type) {
         case GateType::AND:
-            return garble_and_gate(gate, gate_id);
+            garble_and_gate(table, gate, hashes, instance, prg);
+            break;
         case GateType::OR:
-            return garble_or_gate(gate, gate_id);
+            garble_or_gate(table, gate, hashes, instance, prg);
+            break;
         case GateType::XOR:
-            return garble_xor_gate(gate, gate_id);
+            garble_xor_gate(table, gate, hashes, instance, prg);
+            break;
         case GateType::NAND:
-            return garble_nand_gate(gate, gate_id);
+            garble_nand_gate(table, gate, hashes, instance, prg);
+            break;
         case GateType::NOT:
-            return garble_not_gate(gate, gate_id);
+            garble_not_gate(table, gate, hashes, instance, prg);
+            break;
         default:
             throw GarblerException("Unsupported gate type: " + gate_type_to_string(gate.type));
     }
 }
 
-GarbledGate Garbler::garble_and_gate(const Gate& gate, int gate_id) {
-    GarbledGate garbled_gate;
-    
-    auto& out_labels = wire_labels[gate.output_wire];
-    auto& in1_labels = wire_labels[gate.input_wire1];
-    auto& in2_labels = wire_labels[gate.input_wire2];
+void Garbler::garble_and_gate(GarbledGate table, const Gate& gate, const WireLabel* hashes,
+                              GarbleInstance& instance, AesCtrPrg& prg) {
+    const auto& out_labels = output_labels(gate, instance, prg);
+    auto& in1_labels = instance.wire_labels[gate.input_wire1];
+    auto& in2_labels = instance.wire_labels[gate.input_wire2];
     
-    generate_garbled_table(garbled_gate, gate, gate_id,
+    generate_garbled_table(table, gate, hashes, instance, prg,
                           out_labels.first, out_labels.second,
                           in1_labels.first, in1_labels.second,
                           in2_labels.first, in2_labels.second);
-    
-    return garbled_gate;
 }
 
-GarbledGate Garbler::garble_or_gate(const Gate& gate, int gate_id) {
-    GarbledGate garbled_gate;
+void Garbler::garble_or_gate(GarbledGate table, const Gate& gate, const WireLabel* hashes,
+                             GarbleInstance& instance, AesCtrPrg& prg) {
+    const auto& out_labels = output_labels(gate, instance, prg);
+    auto& in1_labels = instance.wire_labels[gate.input_wire1];
+    auto& in2_labels = instance.wire_labels[gate.input_wire2];
     
-    auto& out_labels = wire_labels[gate.output_wire];
-    auto& in1_labels = wire_labels[gate.input_wire1];
-    auto& in2_labels = wire_labels[gate.input_wire2];
-    
-    generate_garbled_table(garbled_gate, gate, gate_id,
+    generate_garbled_table(table, gate, hashes, instance, prg,
                           out_labels.first, out_labels.second,
                           in1_labels.first, in1_labels.second,
                           in2_labels.first, in2_labels.second);
-    
-    return garbled_gate;
 }
 
-GarbledGate Garbler::garble_xor_gate(const Gate& gate, int gate_id) {
-    GarbledGate garbled_gate;
+void Garbler::garble_xor_gate(GarbledGate table, const Gate& gate, const WireLabel* hashes,
+                              GarbleInstance& instance, AesCtrPrg& prg) {
+    auto& in1_labels = instance.wire_labels[gate.input_wire1];
+    auto& in2_labels = instance.wire_labels[gate.input_wire2];
+    
+    if (use_free_xor_) {
+        // Free-XOR: output label0 = in1 label0 ^ in2 label0, no table
+        WireLabel out0 = CryptoUtils::xor_labels(in1_labels.first, in2_labels.first);
+        instance.wire_labels[gate.output_wire] = {out0, CryptoUtils::xor_labels(out0, instance.delta)};
+        return;
+    }
     
-    auto& out_labels = wire_labels[gate.output_wire];
-    auto& in1_labels = wire_labels[gate.input_wire1];
-    auto& in2_labels = wire_labels[gate.input_wire2];
+    const auto& out_labels = output_labels(gate, instance, prg);
     
-    generate_garbled_table(garbled_gate, gate, gate_id,
+    generate_garbled_table(table, gate, hashes, instance, prg,
                           out_labels.first, out_labels.second,
                           in1_labels.first, in1_labels.second,
                           in2_labels.first, in2_labels.second);
-    
-    return garbled_gate;
 }
 
-GarbledGate Garbler::garble_nand_gate(const Gate& gate, int gate_id) {
-    GarbledGate garbled_gate;
+void Garbler::garble_nand_gate(GarbledGate table, const Gate& gate, const WireLabel* hashes,
+                               GarbleInstance& instance, AesCtrPrg& prg) {
+    const auto& out_labels = output_labels(gate, instance, prg);
+    auto& in1_labels = instance.wire_labels[gate.input_wire1];
+    auto& in2_labels = instance.wire_labels[gate.input_wire2];
     
-    auto& out_labels = wire_labels[gate.output_wire];
-    auto& in1_labels = wire_labels[gate.input_wire1];
-    auto& in2_labels = wire_labels[gate.input_wire2];
-    
-    generate_garbled_table(garbled_gate, gate, gate_id,
+    generate_garbled_table(table, gate, hashes, instance, prg,
                           out_labels.first, out_labels.second,
                           in1_labels.first, in1_labels.second,
                           in2_labels.first, in2_labels.second);
-    
-    return garbled_gate;
 }
 
-GarbledGate Garbler::garble_not_gate(const Gate& gate, int gate_id) {
-    GarbledGate garbled_gate;
+void Garbler::garble_not_gate(GarbledGate table, const Gate& gate, const WireLabel* hashes,
+                              GarbleInstance& instance, AesCtrPrg& prg) {
+    auto& in1_labels = instance.wire_labels[gate.input_wire1];
     
-    auto& out_labels = wire_labels[gate.output_wire];
-    auto& in1_labels = wire_labels[gate.input_wire1];
+    if (use_free_xor_) {
+        // NOT is free as well: output label0 = input label0 ^ delta
+        instance.wire_labels[gate.output_wire] = {in1_labels.second, in1_labels.first};
+        return;
+    }
+    
+    const auto& out_labels = output_labels(gate, instance, prg);
     
     // For NOT gate, we only need 2 ciphertexts instead of 4
-    // Encrypt: NOT(0) = 1, NOT(1) = 0
-    
-    garbled_gate.ciphertexts[0] = CryptoUtils::encrypt_label(
-        out_labels.second, // NOT(0) = 1
-        in1_labels.first,  // input label for 0
-        WireLabel{},       // no second input
-        gate_id
-    );
-    
-    garbled_gate.ciphertexts[1] = CryptoUtils::encrypt_label(
-        out_labels.first,  // NOT(1) = 0
-        in1_labels.second, // input label for 1
-        WireLabel{},       // no second input
-        gate_id
-    );
+    // Encrypt: NOT(0) = 1, NOT(1) = 0, keyed by hashes[0] = H(in 0) and hashes[1] = H(in 1)
+    // With point-and-permute the row is the input label's perm bit and rows are 16-byte pads
+    size_t row0 = use_pandp_ ? perm_bit(in1_labels.first) : 0;
+    auto encrypt = [this, &table](size_t row, const WireLabel& label, const WireLabel& hash) {
+        if (use_pandp_) {
+            CryptoUtils::encrypt_label_otp(table.row(row), label, hash);
+        } else {
+            CryptoUtils::encrypt_label(table.row(row), label, hash);
+        }
+    };
+    
+    encrypt(row0, out_labels.second, hashes[0]);     // NOT(0) = 1
+    encrypt(row0 ^ 1, out_labels.first, hashes[1]);  // NOT(1) = 0
     
     // Fill remaining slots with random encrypted data to maintain consistent size
-    auto random_labels = CryptoUtils::generate_random_labels(4);
-    garbled_gate.ciphertexts[2] = CryptoUtils::encrypt_label(random_labels[0], random_labels[1], WireLabel{}, gate_id);
-    garbled_gate.ciphertexts[3] = CryptoUtils::encrypt_label(random_labels[2], random_labels[3], WireLabel{}, gate_id);
+    // (a random key stands in for the hash of a random label)
+    auto random_labels = prg.random_labels(4);
+    encrypt(2, random_labels[0], random_labels[1]);
+    encrypt(3, random_labels[2], random_labels[3]);
     
     if (!use_pandp_) {
-        permute_garbled_table(garbled_gate);
+        permute_garbled_table(table, prg);
+    }
+}
+
+void Garbler::garble_half_gate(GarbledGate table, const Gate& gate, const WireLabel* hashes,
+                               GarbleInstance& instance) {
+    // g(a,b) = ((a ^ alpha) AND (b ^ alpha)) ^ gamma covers AND, NAND and OR;
+    // input inversions just swap which label counts as label0
+    bool alpha = (gate.type == GateType::OR);
+    bool gamma = (gate.type != GateType::AND);
+    
+    const auto& in1_labels = instance.wire_labels[gate.input_wire1];
+    const auto& in2_labels = instance.wire_labels[gate.input_wire2];
+    const WireLabel& a0 = alpha ? in1_labels.second : in1_labels.first;
+    const WireLabel& b0 = alpha ? in2_labels.second : in2_labels.first;
+    
+    uint8_t pa = perm_bit(a0);
+    uint8_t pb = perm_bit(b0);
+    
+    // H(A0), H(A1) under tweak 2g and H(B0), H(B1) under 2g+1 (see gate_hash_queries)
+    const WireLabel& ha0 = hashes[0];
+    const WireLabel& ha1 = hashes[1];
+    const WireLabel& hb0 = hashes[2];
+    const WireLabel& hb1 = hashes[3];
+    
+    // Garbler half-gate (garbler knows pb): TG = H(A0) ^ H(A1) ^ pb*delta
+    WireLabel tg = WireLabel::select(pb, ha0 ^ ha1, ha0 ^ ha1 ^ instance.delta);
+    WireLabel wg0 = WireLabel::select(pa, ha0, ha0 ^ tg);
+    
+    // Evaluator half-gate (evaluator knows b ^ pb): TE = H(B0) ^ H(B1) ^ A0
+    WireLabel hb = hb0 ^ hb1;
+    WireLabel te = hb ^ a0;
+    WireLabel we0 = WireLabel::select(pb, hb0, hb1);
+    
+    WireLabel out0 = WireLabel::select(gamma, wg0 ^ we0, wg0 ^ we0 ^ instance.delta);
+    instance.wire_labels[gate.output_wire] = {out0, out0 ^ instance.delta};
+    
+    std::memcpy(table.row(0), tg.data(), WIRE_LABEL_SIZE);
+    std::memcpy(table.row(1), te.data(), WIRE_LABEL_SIZE);
+}
+
+void Garbler::garble_three_halves_gate(GarbledGate table, const Gate& gate, const WireLabel* hashes,
+                                       GarbleInstance& instance, AesCtrPrg& prg) {
+    // Same input/output inversions as half-gates turn AND into OR and NAND
+    bool alpha = (gate.type == GateType::OR);
+    bool gamma = (gate.type != GateType::AND);
+    
+    const auto& in1_labels = instance.wire_labels[gate.input_wire1];
+    const auto& in2_labels = instance.wire_labels[gate.input_wire2];
+    const WireLabel& a0 = alpha ? in1_labels.second : in1_labels.first;
+    const WireLabel& b0 = alpha ? in2_labels.second : in2_labels.first;
+    uint8_t pa = perm_bit(a0);
+    uint8_t pb = perm_bit(b0);
+    
+    // The evaluator holds the labels A_i, B_j with perm bits (i, j). Everything
+    // below is written in terms of the perm-bit-0 labels A_0 and B_0.
+    WireLabel a_col[2], b_col[2];
+    a_col[pa] = a0;
+    a_col[pa ^ 1] = CryptoUtils::xor_labels(a0, instance.delta);
+    b_col[pb] = b0;
+    b_col[pb ^ 1] = CryptoUtils::xor_labels(b0, instance.delta);
+    
+    // H(A_c), H(B_c) and H(A_0 ^ B_c) under tweaks 3g, 3g+1, 3g+2 (see gate_hash_queries)
+    WireLabel ha[2], hb[2], hx[2];
+    for (int c = 0; c < 2; ++c) {
+        ha[c] = hashes[3 * c];
+        hb[c] = hashes[3 * c + 1];
+        hx[c] = hashes[3 * c + 2];
+    }
+    
+    // The evaluator in row (i, j) computes
+    //   C_L = H(A_i) ^ H(A_i ^ B_j) ^ i*G0 ^ (i^j)*G2 ^ [phi(w)]A_i ^ [w ^ (i,0)]B_j
+    //   C_R = H(B_j) ^ H(A_i ^ B_j) ^ j*G1 ^ (i^j)*G2 ^ [w ^ (0,j)]A_i ^ [phi^2(w)]B_j
+    // where [c]X applies a coefficient row to the halves of X and w are the row's
+    // control bits. With r random and v = (pa, pb), the rows get
+    //   w00 = r, w01 = r ^ phi(v), w10 = r ^ phi^2(v), w11 = r ^ v
+    // so each row alone sees uniformly random control bits.
+    uint8_t v = static_cast<uint8_t>((pa << 1) | pb);
+    uint8_t r = static_cast<uint8_t>(prg.random_u64() & 0x3);
+    uint8_t e = phi(v);
+    uint8_t f = phi(e);
+    uint8_t w[4] = {r, static_cast<uint8_t>(r ^ e), static_cast<uint8_t>(r ^ f), static_cast<uint8_t>(r ^ v)};
+    
+    LabelHalves a = split_label(a_col[0]);
+    LabelHalves b = split_label(b_col[0]);
+    LabelHalves d = split_label(instance.delta);
+    auto h = [](const WireLabel& x) { return load_half(x.data()); };
+    
+    uint64_t g0 = h(ha[0]) ^ h(ha[1]) ^ select_halves(e, a) ^ select_halves(0x2 ^ v, b) ^
+                  select_halves((pb ? 0x3 : 0) ^ phi(phi(w[2])), d);
+    uint64_t g1 = h(hb[0]) ^ h(hb[1]) ^ select_halves(0x1 ^ v, a) ^ select_halves(f, b) ^
+                  select_halves((pa ? 0x3 : 0) ^ phi(w[1]), d);
+    uint64_t g2 = h(hx[0]) ^ h(hx[1]) ^ select_halves(f, a) ^ select_halves(e, b) ^
+                  select_halves((pb ? 0x1 : 0) ^ w[2], d);
+    
+    // Output label for row (0, 0), shifted to the AND-false label
+    uint64_t c_l = h(ha[0]) ^ h(hx[0]) ^ select_halves(phi(r), a) ^ select_halves(r, b);
+    uint64_t c_r = h(hb[0]) ^ h(hx[0]) ^ select_halves(r, a) ^ select_halves(phi(phi(r)), b);
+    WireLabel out0 = join_halves(c_l, c_r);
+    if ((pa & pb) ^ gamma) out0 = CryptoUtils::xor_labels(out0, instance.delta);
+    instance.wire_labels[gate.output_wire] = {out0, CryptoUtils::xor_labels(out0, instance.delta)};
+    
+    uint8_t control = 0;
+    for (size_t i = 0; i < 2; ++i) {
+        for (size_t j = 0; j < 2; ++j) {
+            size_t row = 2 * i + j;
+            uint8_t masked = w[row] ^ control_mask(ha[i], hb[j], row);
+            control |= static_cast<uint8_t>(masked << (2 * row));
+        }
     }
     
-    return garbled_gate;
+    std::memcpy(table.row(0), &g0, 8);
+    std::memcpy(table.row(1), &g1, 8);
+    std::memcpy(table.row(2), &g2, 8);
+    *table.row(THREE_HALVES_CONTROL_ROW) = control;
 }
 
-void Garbler::generate_garbled_table(GarbledGate& garbled_gate,
+void Garbler::generate_garbled_table(GarbledGate table,
                                    const Gate& gate, 
-                                   int gate_id,
+                                   const WireLabel* row_hashes,
+                                   GarbleInstance& instance,
+                                   AesCtrPrg& prg,
                                    const WireLabel& out_label0,
                                    const WireLabel& out_label1,
                                    const WireLabel& in1_label0,
@@ -516,58 +964,91 @@ void Garbler::generate_garbled_table(GarbledGate& garbled_gate,
     // for (int j = 0; j < 8; ++j) std::cout << std::hex << (int)out_label1[j];
     // std::cout << std::endl;
     
-    // Generate all 4 ciphertexts for the truth table
+    // Generate the ciphertexts for the truth table
     // Entry (a,b): encrypt output_label_for_gate(a,b) with input_labels(a,b)
+    WireLabel out0 = out_label0;
+    WireLabel out1 = out_label1;
+    if (use_pandp_) {
+        derive_grr3_output_labels(gate, row_hashes, instance, prg, in1_label0, in2_label0, out0, out1);
+    }
     
-    // (0,0)
-    bool result_00 = gate_function(gate.type, false, false);
-    WireLabel result_label_00 = result_00 ? out_label1 : out_label0;
-    auto ct0 = CryptoUtils::encrypt_label(result_label_00, in1_label0, in2_label0, gate_id);
-    garbled_gate.ciphertexts[0] = ct0;
-    
-    // (0,1)  
-    bool result_01 = gate_function(gate.type, false, true);
-    WireLabel result_label_01 = result_01 ? out_label1 : out_label0;
-    auto ct1 = CryptoUtils::encrypt_label(result_label_01, in1_label0, in2_label1, gate_id);
-    garbled_gate.ciphertexts[1] = ct1;
-    
-    // (1,0)
-    bool result_10 = gate_function(gate.type, true, false);
-    WireLabel result_label_10 = result_10 ? out_label1 : out_label0;
-    auto ct2 = CryptoUtils::encrypt_label(result_label_10, in1_label1, in2_label0, gate_id);
-    garbled_gate.ciphertexts[2] = ct2;
-    
-    // (1,1)
-    bool result_11 = gate_function(gate.type, true, true);
-    WireLabel result_label_11 = result_11 ? out_label1 : out_label0;
-    auto ct3 = CryptoUtils::encrypt_label(result_label_11, in1_label1, in2_label1, gate_id);
-    garbled_gate.ciphertexts[3] = ct3;
+    const WireLabel* in1_labels[2] = {&in1_label0, &in1_label1};
+    const WireLabel* in2_labels[2] = {&in2_label0, &in2_label1};
+    for (int a = 0; a < 2; ++a) {
+        for (int b = 0; b < 2; ++b) {
+            const WireLabel& in1 = *in1_labels[a];
+            const WireLabel& in2 = *in2_labels[b];
+            WireLabel result_label = gate_function(gate.type, a, b) ? out1 : out0;
+            const WireLabel& row_hash = row_hashes[a * 2 + b];
+            
+            if (use_pandp_) {
+                // Canonical ordering by permutation bits => index = perm(in1)*2 + perm(in2);
+                // row 0 is implied by the derived output label (GRR3), rows 1-3 are
+                // stored as 16-byte one-time pads
+                size_t idx = static_cast<size_t>(perm_bit(in1) * 2 + perm_bit(in2));
+                if (idx != 0) {
+                    CryptoUtils::encrypt_label_otp(table.row(idx - 1), result_label, row_hash);
+                }
+            } else {
+                CryptoUtils::encrypt_label(table.row(a * 2 + b), result_label, row_hash);
+            }
+        }
+    }
     
-    if (use_pandp_) {
-        // Canonical ordering by permutation bits (a = perm(in1), b = perm(in2)) => index = a*2 + b
-        std::array<std::vector<uint8_t>,4> ordered{};
-        // Compute perm bits
-        uint8_t a0 = perm_bit(in1_label0);
-        uint8_t a1 = perm_bit(in1_label1);
-        uint8_t b0 = perm_bit(in2_label0);
-        uint8_t b1 = perm_bit(in2_label1);
-        // Map (actual input bit, perm bit) to index
-        ordered[a0 * 2 + b0] = garbled_gate.ciphertexts[0]; // (0,0)
-        ordered[a0 * 2 + b1] = garbled_gate.ciphertexts[1]; // (0,1)
-        ordered[a1 * 2 + b0] = garbled_gate.ciphertexts[2]; // (1,0)
-        ordered[a1 * 2 + b1] = garbled_gate.ciphertexts[3]; // (1,1)
-        garbled_gate.ciphertexts = ordered;
-    } else {
+    if (!use_pandp_) {
         // Randomly permute the table to hide the mapping
-        permute_garbled_table(garbled_gate);
+        permute_garbled_table(table, prg);
     }
 }
 
-void Garbler::permute_garbled_table(GarbledGate& garbled_gate) {
-    // Randomly permute the 4 ciphertexts
-    std::random_device rd;
-    std::mt19937 g(rd());
-    std::shuffle(garbled_gate.ciphertexts.begin(), garbled_gate.ciphertexts.end(), g);
+void Garbler::derive_grr3_output_labels(const Gate& gate,
+                                        const WireLabel* row_hashes,
+                                        GarbleInstance& instance,
+                                        AesCtrPrg& prg,
+                                        const WireLabel& in1_label0,
+                                        const WireLabel& in2_label0,
+                                        WireLabel& out_label0,
+                                        WireLabel& out_label1) {
+    // The perm-bit-0 label of a wire carries the value perm(label0)
+    bool a = perm_bit(in1_label0) != 0;
+    bool b = perm_bit(in2_label0) != 0;
+    
+    // Row (0,0) encrypts its output label under H(in1 label a, in2 label b, gate_id);
+    // setting the label to that hash makes the ciphertext all zero, so it is never sent
+    WireLabel derived = row_hashes[a * 2 + b];
+    WireLabel other;
+    if (use_free_xor_) {
+        other = CryptoUtils::xor_labels(derived, instance.delta);
+    } else {
+        other = prg.random_label();
+        other[WIRE_LABEL_SIZE - 1] = (other[WIRE_LABEL_SIZE - 1] & 0xFE) | (perm_bit(derived) ^ 1);
+    }
+    
+    bool result = gate_function(gate.type, a, b);
+    out_label0 = WireLabel::select(result, derived, other);
+    out_label1 = WireLabel::select(result, other, derived);
+    instance.wire_labels[gate.output_wire] = {out_label0, out_label1};
+}
+
+void Garbler::permute_garbled_table(GarbledGate table, AesCtrPrg& prg) {
+    // Randomly permute the 4 ciphertexts (Fisher-Yates; the modulo bias of a
+    // 64-bit draw is negligible), swapping rows in place in the arena
+    uint8_t tmp[WIRE_LABEL_SIZE + 16];
+    for (size_t i = table.rows - 1; i > 0; --i) {
+        size_t j = static_cast<size_t>(prg.random_u64() % (i + 1));
+        if (i == j) continue;
+        std::memcpy(tmp, table.row(i), table.stride);
+        std::memcpy(table.row(i), table.row(j), table.stride);
+        std::memcpy(table.row(j), tmp, table.stride);
+    }
+}
+
+void Garbler::set_threads(size_t num_threads) {
+    pool_ = std::make_unique<ThreadPool>(num_threads);
+}
+
+void Garbler::set_seed(uint64_t seed) {
+    prg_.reseed(AesCtrPrg::seed_from_u64(seed));
 }
 
 std::vector<WireLabel> Garbler::encode_inputs(const GarbledCircuit& gc, 
@@ -584,13 +1065,13 @@ std::vector<WireLabel> Garbler::encode_inputs(const GarbledCircuit& gc,
         int wire_id = wire_indices[i];
         bool input_bit = inputs[i];
         
-        auto it = gc.input_labels.find(wire_id);
-        if (it == gc.input_labels.end()) {
+        if (wire_id <= 0 || static_cast<size_t>(wire_id) >= gc.input_labels.size()) {
             throw GarblerException("Wire not found: " + std::to_string(wire_id));
         }
         
         // Choose label based on input bit: 0 -> first label, 1 -> second label
-        WireLabel label = input_bit ? it->second.second : it->second.first;
+        const auto& labels = gc.input_labels[wire_id];
+        WireLabel label = input_bit ? labels.second : labels.first;
         encoded_labels.push_back(label);
     }
     
@@ -603,16 +1084,14 @@ std::vector<bool> Garbler::decode_outputs(const GarbledCircuit& gc,
     results.reserve(output_labels.size());
     
     for (size_t i = 0; i < output_labels.size() && i < gc.circuit.output_wires.size(); ++i) {
-        int output_wire = gc.circuit.output_wires[i];
         const WireLabel& result_label = output_labels[i];
         
-        auto it = gc.output_mapping.find(output_wire);
-        if (it == gc.output_mapping.end()) {
+        if (i >= gc.output_mapping.size()) {
             throw GarblerException("Output wire mapping not found");
         }
         
         // Compare with the "0" label to determine the bit value
-        bool labels_match = CryptoUtils::labels_equal(result_label, it->second);
+        bool labels_match = CryptoUtils::labels_equal(result_label, gc.output_mapping[i]);
         bool bit_value = !labels_match;
         
         results.push_back(bit_value);
@@ -628,79 +1107,163 @@ std::vector<std::pair<WireLabel, WireLabel>> Garbler::get_ot_input_pairs(
     pairs.reserve(wire_indices.size());
     
     for (int wire_id : wire_indices) {
-        auto it = gc.input_labels.find(wire_id);
-        if (it == gc.input_labels.end()) {
+        if (wire_id <= 0 || static_cast<size_t>(wire_id) >= gc.input_labels.size()) {
             throw GarblerException("Wire not found for OT: " + std::to_string(wire_id));
         }
         
-        
-        pairs.push_back(it->second);
+        pairs.push_back(gc.input_labels[wire_id]);
     }
     
     return pairs;
 }
 
-// Defaulted via Evaluator(bool use_pandp = false)
-Evaluator::Evaluator(bool use_pandp) : use_pandp_(use_pandp) { reset_stats(); }
+// Defaulted via Evaluator(bool use_pandp = false, bool use_free_xor = false, STANDARD)
+Evaluator::Evaluator(bool use_pandp, bool use_free_xor, GarblingScheme scheme)
+    : use_pandp_(use_pandp), use_free_xor_(use_free_xor), scheme_(scheme),
+      pool_(std::make_unique<ThreadPool>(1)) { reset_stats(); }
+
+void Evaluator::set_threads(size_t num_threads) {
+    pool_ = std::make_unique<ThreadPool>(num_threads);
+}
 
 std::vector<WireLabel> Evaluator::evaluate_circuit(const GarbledCircuit& gc,
                                                   const std::vector<WireLabel>& input_labels) {
     LOG_INFO("Evaluating garbled circuit with " << gc.circuit.gates.size() << " gates");
     
+    start_evaluation(gc, input_labels, CircuitUtils::topological_levels(gc));
+    auto start_time = std::chrono::high_resolution_clock::now();
+    evaluate_levels(gc, 0, levels_.size(), gc.tables.data(), 0);
+    return finish_evaluation(gc, start_time);
+}
+
+std::vector<WireLabel> Evaluator::evaluate_circuit_streaming(const GarbledCircuit& gc,
+                                                            const std::vector<WireLabel>& input_labels,
+                                                            size_t chunk_bytes, size_t queue_depth,
+                                                            const std::function<void(uint8_t*, size_t)>& receive_chunk) {
+    LOG_INFO("Evaluating garbled circuit with " << gc.circuit.gates.size() << " gates as its "
+             << gc.table_bytes() << " bytes of tables arrive");
+    
+    // Chunks of circuit order, each levelled on its own: once a chunk's tables are
+    // in, its gates can be evaluated, whatever chunking the garbler used
+    auto chunk_ends = CircuitUtils::stream_chunk_ends(gc, chunk_bytes);
+    start_evaluation(gc, input_labels, CircuitUtils::topological_levels(gc, chunk_ends));
+    auto start_time = std::chrono::high_resolution_clock::now();
     
-    wire_values.clear();
+    // The receiver thread reads up to queue_depth chunks ahead of the evaluation;
+    // a buffer goes back for reuse once its gates are evaluated, so no more than
+    // queue_depth + 2 chunks are ever held
+    BoundedQueue<TableBuffer> ready(queue_depth);
+    BoundedQueue<TableBuffer> spare(queue_depth + 2);
+    std::exception_ptr receive_error;
+    std::thread receiver([&] {
+        try {
+            size_t begin = 0;
+            for (size_t end : chunk_ends) {
+                TableBuffer chunk;
+                spare.try_pop(chunk);
+                chunk.resize(gc.table_offsets[end] - gc.table_offsets[begin]);
+                if (!chunk.empty()) {
+                    receive_chunk(chunk.data(), chunk.size());
+                }
+                begin = end;
+                if (!ready.push(std::move(chunk))) {
+                    return;
+                }
+            }
+        } catch (...) {
+            receive_error = std::current_exception();
+            ready.close();
+        }
+    });
+    
+    try {
+        size_t level = 0;
+        size_t begin = 0;
+        for (size_t end : chunk_ends) {
+            // A closed queue means the receiver failed; its error is rethrown below
+            TableBuffer chunk;
+            if (!ready.pop(chunk)) {
+                break;
+            }
+            size_t level_end = CircuitUtils::chunk_levels_end(levels_, level, end);
+            evaluate_levels(gc, level, level_end, chunk.data(), gc.table_offsets[begin]);
+            level = level_end;
+            begin = end;
+            spare.push(std::move(chunk));
+        }
+    } catch (...) {
+        ready.close();
+        receiver.join();
+        throw;
+    }
+    receiver.join();
+    if (receive_error) {
+        std::rethrow_exception(receive_error);
+    }
     
+    return finish_evaluation(gc, start_time);
+}
+
+void Evaluator::start_evaluation(const GarbledCircuit& gc, const std::vector<WireLabel>& input_labels,
+                                 std::vector<std::vector<size_t>> levels) {
     // Set input wire values
     if (input_labels.size() != gc.circuit.input_wires.size()) {
         throw EvaluatorException("Input label count mismatch");
     }
     
+    // Dense wire ids are what make flat storage safe for a circuit off the network
+    if (!CircuitUtils::has_dense_wires(gc.circuit)) {
+        throw EvaluatorException("Circuit wiring is malformed or not densely numbered");
+    }
+    
+    if (gc.point_and_permute != use_pandp_ || gc.free_xor != use_free_xor_ || gc.scheme != scheme_) {
+        throw EvaluatorException("Garbling mode of the circuit does not match the evaluator settings");
+    }
+    
+    // Labels live in slots that are reused once their wire is dead. As when
+    // garbling, the non-free gates heading each level run in parallel
+    levels_ = std::move(levels);
+    level_table_gates_ = CircuitUtils::table_gate_counts(gc, levels_);
+    slots_ = CircuitUtils::assign_wire_slots(gc.circuit, levels_, level_table_gates_);
+    wire_values.assign(slots_.num_slots, WireLabel{});
+    
     for (size_t i = 0; i < input_labels.size(); ++i) {
-        wire_values[gc.circuit.input_wires[i]] = input_labels[i];
+        wire_values[slots_.input_slots[i]] = input_labels[i];
     }
     
-    // Evaluate gates
-    auto start_time = std::chrono::high_resolution_clock::now();
-    for (size_t i = 0; i < gc.circuit.gates.size(); ++i) {
-        const auto& gate = gc.circuit.gates[i];
-        const auto& garbled_gate = gc.garbled_gates[i];
-        
-        WireLabel result_label;
-        
-        if (gate.input_wire2 == -1) {
-            // Unary gate
-            auto input_it = wire_values.find(gate.input_wire1);
-            if (input_it == wire_values.end()) {
-                throw EvaluatorException("Input wire not found: " + std::to_string(gate.input_wire1));
-            }
-            
-            result_label = evaluate_unary_gate(garbled_gate, input_it->second, i);
-        } else {
-            // Binary gate
-            auto input1_it = wire_values.find(gate.input_wire1);
-            auto input2_it = wire_values.find(gate.input_wire2);
-            
-            if (input1_it == wire_values.end() || input2_it == wire_values.end()) {
-                throw EvaluatorException("Input wires not found for gate");
-            }
-            
-            result_label = evaluate_gate(garbled_gate, input1_it->second, input2_it->second, i);
-        }
-        
-        wire_values[gate.output_wire] = result_label;
-        eval_stats.gates_evaluated++;
+    // Each worker counts into its own stats, summed once the circuit is done
+    workers_.clear();
+    for (size_t w = 0; w < pool_->size(); ++w) {
+        workers_.push_back(std::make_unique<EvalWorker>());
+    }
+}
+
+void Evaluator::evaluate_levels(const GarbledCircuit& gc, size_t first, size_t last,
+                                const uint8_t* window, size_t window_start) {
+    // Evaluate level by level: the workers take windows of up to GATE_BATCH_SIZE
+    // independent gates, then the caller evaluates the level's free gates in order
+    for (size_t l = first; l < last; ++l) {
+        const auto& level = levels_[l];
+        size_t parallel = level_table_gates_[l];
+        pool_->parallel_for(parallel, GATE_BATCH_SIZE, [&](size_t begin, size_t end, size_t w) {
+            evaluate_gates(gc, level.data() + begin, end - begin, *workers_[w], window, window_start);
+        });
+        evaluate_gates(gc, level.data() + parallel, level.size() - parallel, *workers_[0], window, window_start);
+    }
+}
+
+std::vector<WireLabel> Evaluator::finish_evaluation(const GarbledCircuit& gc,
+                                                    std::chrono::high_resolution_clock::time_point start_time) {
+    for (const auto& worker : workers_) {
+        eval_stats.merge(worker->stats);
     }
     auto end_time = std::chrono::high_resolution_clock::now();
     
     std::vector<WireLabel> output_labels;
     output_labels.reserve(gc.circuit.output_wires.size());
     
-    for (int output_wire : gc.circuit.output_wires) {
-        auto it = wire_values.find(output_wire);
-        if (it == wire_values.end()) {
-            throw EvaluatorException("Output wire not found: " + std::to_string(output_wire));
-        }
-        output_labels.push_back(it->second);
+    for (int slot : slots_.output_slots) {
+        output_labels.push_back(wire_values[slot]);
     }
     
     std::cout << "[EVAL DEBUG] Final output labels (to be sent to garbler):" << std::endl;
@@ -720,12 +1283,103 @@ std::vector<WireLabel> Evaluator::evaluate_circuit(const GarbledCircuit& gc,
     return output_labels;
 }
 
-WireLabel Evaluator::evaluate_gate(const GarbledGate& garbled_gate,
+void Evaluator::evaluate_gates(const GarbledCircuit& gc, const size_t* gates, size_t count, EvalWorker& worker,
+                               const uint8_t* window, size_t window_start) {
+    const WireSlotPlan& slots = slots_;
+    auto find_label = [this](int wire) -> const WireLabel& { return wire_values[wire]; };
+    
+    for (size_t start = 0; start < count; start += GATE_BATCH_SIZE) {
+        size_t end = std::min(count, start + GATE_BATCH_SIZE);
+        worker.queries.clear();
+        worker.offsets.clear();
+        for (size_t k = start; k < end; ++k) {
+            size_t i = gates[k];
+            const auto& gate = slots.gates[i];
+            worker.offsets.push_back(worker.queries.size());
+            if (gc.is_free_gate(gate.type)) {
+                continue;
+            }
+            if (gate.input_wire2 == -1) {
+                worker.queries.push_back({find_label(gate.input_wire1), WireLabel{}, static_cast<uint64_t>(i)});
+            } else {
+                binary_gate_queries(find_label(gate.input_wire1), find_label(gate.input_wire2),
+                                    static_cast<int>(i), worker.queries);
+            }
+        }
+        worker.hashes.resize(worker.queries.size());
+        CryptoUtils::PRF_batch(worker.queries.data(), worker.hashes.data(), worker.queries.size());
+        
+        for (size_t k = start; k < end; ++k) {
+            size_t i = gates[k];
+            const auto& gate = slots.gates[i];
+            ConstGarbledGate garbled_gate = gc.gate_table(i, window, window_start);
+            const WireLabel* gate_hashes = worker.hashes.data() + worker.offsets[k - start];
+            
+            WireLabel result_label;
+            
+            if (gc.is_free_gate(gate.type)) {
+                // Free-XOR: XOR the input labels, NOT passes its label through
+                if (gate.type == GateType::NOT) {
+                    result_label = find_label(gate.input_wire1);
+                } else {
+                    result_label = CryptoUtils::xor_labels(find_label(gate.input_wire1),
+                                                           find_label(gate.input_wire2));
+                }
+            } else if (gate.input_wire2 == -1) {
+                // Unary gate
+                result_label = evaluate_unary_gate(garbled_gate, find_label(gate.input_wire1),
+                                                   static_cast<int>(i), gate_hashes[0], worker.stats);
+            } else {
+                // Binary gate
+                result_label = evaluate_gate(garbled_gate, find_label(gate.input_wire1),
+                                             find_label(gate.input_wire2), static_cast<int>(i),
+                                             gate_hashes, worker.stats);
+            }
+            
+            wire_values[gate.output_wire] = result_label;
+            worker.stats.gates_evaluated++;
+        }
+    }
+}
+
+void Evaluator::binary_gate_queries(const WireLabel& input1_label,
+                                    const WireLabel& input2_label,
+                                    int gate_id,
+                                    std::vector<HashQuery>& queries) {
+    if (scheme_ == GarblingScheme::HALF_GATES) {
+        uint64_t tweak_g = 2 * static_cast<uint64_t>(gate_id);
+        queries.push_back({input1_label, WireLabel{}, tweak_g});
+        queries.push_back({input2_label, WireLabel{}, tweak_g + 1});
+    } else if (scheme_ == GarblingScheme::THREE_HALVES) {
+        uint64_t tweak = 3 * static_cast<uint64_t>(gate_id);
+        queries.push_back({input1_label, WireLabel{}, tweak});
+        queries.push_back({input2_label, WireLabel{}, tweak + 1});
+        queries.push_back({CryptoUtils::xor_labels(input1_label, input2_label), WireLabel{}, tweak + 2});
+    } else {
+        // Garbled truth table: every row is keyed by the same H(in1, in2, gate_id)
+        queries.push_back({input1_label, input2_label, static_cast<uint64_t>(gate_id)});
+    }
+}
+
+WireLabel Evaluator::evaluate_gate(ConstGarbledGate garbled_gate,
                                   const WireLabel& input1_label,
                                   const WireLabel& input2_label,
                                   int gate_id) {
-    eval_stats.decryption_attempts++;
+    std::vector<HashQuery> queries;
+    binary_gate_queries(input1_label, input2_label, gate_id, queries);
+    auto hashes = CryptoUtils::PRF_batch(queries);
+    return evaluate_gate(garbled_gate, input1_label, input2_label, gate_id, hashes.data(), eval_stats);
+}
 
+WireLabel Evaluator::evaluate_gate(ConstGarbledGate garbled_gate,
+                                  const WireLabel& input1_label,
+                                  const WireLabel& input2_label,
+                                  int gate_id,
+                                  const WireLabel* hashes,
+                                  EvaluationStats& stats) {
+    stats.decryption_attempts++;
+
+#ifdef DEBUG
     // Print the input labels being used
     std::cout << "[EVAL DEBUG] Gate " << gate_id << " - Input labels received:" << std::endl;
     std::cout << "             Input1 label: ";
@@ -739,106 +1393,143 @@ WireLabel Evaluator::evaluate_gate(const GarbledGate& garbled_gate,
         std::cout << std::hex << std::setw(2) << std::setfill('0') << (int)input2_label[j];
     }
     std::cout << std::dec << std::endl;
+#endif
+
+    if (scheme_ == GarblingScheme::HALF_GATES) {
+        return evaluate_half_gate(garbled_gate, input1_label, input2_label, hashes, stats);
+    }
+    if (scheme_ == GarblingScheme::THREE_HALVES) {
+        return evaluate_three_halves_gate(garbled_gate, input1_label, input2_label, hashes, stats);
+    }
 
     if (use_pandp_) {
         // Directly select row using permutation bits
         uint8_t a = perm_bit(input1_label);
         uint8_t b = perm_bit(input2_label);
         size_t idx = static_cast<size_t>(a * 2 + b);
+        if (idx == 0) {
+            // GRR3: row 0 is not transmitted, its output label is the hash itself
+            stats.cipher_decryptions++;
+            stats.successful_decryptions++;
+            return hashes[0];
+        }
         try {
-            WireLabel result = CryptoUtils::decrypt_label(
-                garbled_gate.ciphertexts[idx], input1_label, input2_label, gate_id);
-                eval_stats.cipher_decryptions++;
-            eval_stats.successful_decryptions++;
+            WireLabel result = CryptoUtils::decrypt_label_otp(garbled_gate.row(idx - 1), hashes[0]);
+            stats.cipher_decryptions++;
+            stats.successful_decryptions++;
             return result;
         } catch (const CryptoException& e) {
-            eval_stats.cipher_decryptions++;
+            stats.cipher_decryptions++;
             throw EvaluatorException(std::string("Point-and-permute decryption failed: ") + e.what());
         }
-    } else {
-        // Try to decrypt each ciphertext in the garbled table
-        int count = 0;
-        for (size_t i = 0; i < 4; ++i) {
-            try {
-                WireLabel result = CryptoUtils::decrypt_label(
-                    garbled_gate.ciphertexts[i], input1_label, input2_label, gate_id);
-                eval_stats.cipher_decryptions++;
-                eval_stats.successful_decryptions++;
-                std::cout<<"             "<<++count<<" ciphers are decrypted"<<std::endl;
-                return result;
-            } catch (const CryptoException&) {
-                eval_stats.cipher_decryptions++;
-                count++;
-                continue;
-            }
-        }
-        throw EvaluatorException("Failed to decrypt any ciphertext in garbled gate " + std::to_string(gate_id));
     }
-    throw EvaluatorException("Failed to decrypt any ciphertext in garbled gate " + std::to_string(gate_id));
+    
+    // Trial-decrypt all rows of the garbled table at once
+    return try_decrypt_gate(garbled_gate, hashes[0], gate_id, stats);
 }
 
-WireLabel Evaluator::evaluate_unary_gate(const GarbledGate& garbled_gate,
+WireLabel Evaluator::evaluate_unary_gate(ConstGarbledGate garbled_gate,
                                         const WireLabel& input_label,
                                         int gate_id) {
-    eval_stats.decryption_attempts++;
+    return evaluate_unary_gate(garbled_gate, input_label, gate_id,
+                               CryptoUtils::PRF(input_label, WireLabel{}, gate_id), eval_stats);
+}
+
+WireLabel Evaluator::evaluate_unary_gate(ConstGarbledGate garbled_gate,
+                                        const WireLabel& input_label,
+                                        int gate_id,
+                                        const WireLabel& hash,
+                                        EvaluationStats& stats) {
+    stats.decryption_attempts++;
     if (use_pandp_) {
         // Point-and-permute for unary gates: index by the input label's perm bit
-        uint8_t a = perm_bit(input_label);        // 0 for label0, 1 for label1
+        uint8_t a = perm_bit(input_label);
         size_t idx = static_cast<size_t>(a);
         try {
-            WireLabel result = CryptoUtils::decrypt_label(
-                garbled_gate.ciphertexts[idx], input_label, WireLabel{}, gate_id);
-            eval_stats.cipher_decryptions++;
-            eval_stats.successful_decryptions++;
+            WireLabel result = CryptoUtils::decrypt_label_otp(garbled_gate.row(idx), hash);
+            stats.cipher_decryptions++;
+            stats.successful_decryptions++;
             return result;
         } catch (const CryptoException& e) {
-            eval_stats.cipher_decryptions++;
+            stats.cipher_decryptions++;
             throw EvaluatorException(std::string("Point-and-permute (unary) decryption failed: ") + e.what());
         }
-    }else{
-        int count = 0;
-        for (size_t i = 0; i < 4; ++i) {
-            try {
-                WireLabel result = CryptoUtils::decrypt_label(
-                    garbled_gate.ciphertexts[i], input_label, WireLabel{}, gate_id);
-                eval_stats.cipher_decryptions++;
-                eval_stats.successful_decryptions++;
-                std::cout<<"             "<<++count<<" ciphers are decrypted"<<std::endl;
-                return result;
-            } catch (const CryptoException&) {
-                eval_stats.cipher_decryptions++;
-                continue; // try next ciphertext
-            }
-        }
-        throw EvaluatorException("Failed to decrypt unary gate " + std::to_string(gate_id));
     }
+    
+    return try_decrypt_gate(garbled_gate, hash, gate_id, stats);
 }
 
-WireLabel Evaluator::try_decrypt_gate(const GarbledGate& garbled_gate,
-                                     const WireLabel& input1,
-                                     const WireLabel& input2,
-                                     int gate_id) {
-    for (size_t i = 0; i < 4; ++i) {
-        try {
-            return CryptoUtils::decrypt_label(garbled_gate.ciphertexts[i], input1, input2, gate_id);
-        } catch (...) {
-            continue;
-        }
+WireLabel Evaluator::try_decrypt_gate(ConstGarbledGate garbled_gate,
+                                     const WireLabel& hash,
+                                     int gate_id,
+                                     EvaluationStats& stats) {
+    // One batched AES pass over all four rows; a wrong row is a status, not an exception
+    WireLabel result;
+    int row = CryptoUtils::try_decrypt_rows(garbled_gate.data, garbled_gate.rows, hash, result);
+    stats.cipher_decryptions += static_cast<int>(garbled_gate.rows);
+    if (row < 0) {
+        throw EvaluatorException("Failed to decrypt any ciphertext in garbled gate " + std::to_string(gate_id));
     }
-    throw EvaluatorException("All decryptions failed");
+    stats.successful_decryptions++;
+    return result;
 }
 
-WireLabel Evaluator::try_decrypt_unary_gate(const GarbledGate& garbled_gate,
-                                           const WireLabel& input,
-                                           int gate_id) {
-    for (size_t i = 0; i < 4; ++i) {
-        try {
-            return CryptoUtils::decrypt_label(garbled_gate.ciphertexts[i], input, WireLabel{}, gate_id);
-        } catch (...) {
-            continue;
-        }
+WireLabel Evaluator::evaluate_half_gate(ConstGarbledGate garbled_gate,
+                                       const WireLabel& input1_label,
+                                       const WireLabel& input2_label,
+                                       const WireLabel* hashes,
+                                       EvaluationStats& stats) {
+    WireLabel tg = CryptoUtils::deserialize_label(garbled_gate.row(0));
+    WireLabel te = CryptoUtils::deserialize_label(garbled_gate.row(1));
+    
+    // Garbler half: WG = H(A) ^ sa*TG, H(A) under tweak 2g
+    WireLabel wg = WireLabel::select(perm_bit(input1_label), hashes[0], hashes[0] ^ tg);
+    
+    // Evaluator half: WE = H(B) ^ sb*(TE ^ A), H(B) under tweak 2g+1
+    WireLabel we = WireLabel::select(perm_bit(input2_label), hashes[1], hashes[1] ^ te ^ input1_label);
+    
+    stats.cipher_decryptions += 2;
+    stats.successful_decryptions++;
+    return CryptoUtils::xor_labels(wg, we);
+}
+
+WireLabel Evaluator::evaluate_three_halves_gate(ConstGarbledGate garbled_gate,
+                                               const WireLabel& input1_label,
+                                               const WireLabel& input2_label,
+                                               const WireLabel* hashes,
+                                               EvaluationStats& stats) {
+    uint8_t i = perm_bit(input1_label);
+    uint8_t j = perm_bit(input2_label);
+    size_t row = 2 * i + j;
+    
+    // H(A), H(B), H(A ^ B) under tweaks 3g, 3g+1, 3g+2
+    const WireLabel& ha = hashes[0];
+    const WireLabel& hb = hashes[1];
+    const WireLabel& hx = hashes[2];
+    
+    uint8_t control = *garbled_gate.row(THREE_HALVES_CONTROL_ROW);
+    uint8_t w = ((control >> (2 * row)) & 0x3) ^ control_mask(ha, hb, row);
+    
+    uint64_t g0 = load_half(garbled_gate.row(0));
+    uint64_t g1 = load_half(garbled_gate.row(1));
+    uint64_t g2 = load_half(garbled_gate.row(2));
+    LabelHalves a = split_label(input1_label);
+    LabelHalves b = split_label(input2_label);
+    
+    uint64_t c_l = load_half(ha.data()) ^ load_half(hx.data()) ^ select_halves(phi(w), a) ^
+                   select_halves(w ^ (i ? 0x2 : 0), b);
+    uint64_t c_r = load_half(hb.data()) ^ load_half(hx.data()) ^ select_halves(w ^ (j ? 0x1 : 0), a) ^
+                   select_halves(phi(phi(w)), b);
+    if (i) c_l ^= g0;
+    if (j) c_r ^= g1;
+    if (i ^ j) {
+        c_l ^= g2;
+        c_r ^= g2;
     }
-    throw EvaluatorException("All unary decryptions failed");
+    
+    stats.cipher_decryptions += 3;
+    stats.successful_decryptions++;
+    return join_halves(c_l, c_r);
 }
 
 bool Evaluator::validate_inputs(const GarbledCircuit& gc, const std::vector<WireLabel>& inputs) {
@@ -852,7 +1543,11 @@ std::vector<bool> CircuitUtils::evaluate_plaintext(const Circuit& circuit,
         throw std::invalid_argument("Input size mismatch");
     }
     
-    std::map<int, bool> wire_values;
+    if (!has_dense_wires(circuit)) {
+        throw std::invalid_argument("Circuit wiring is malformed or not densely numbered");
+    }
+    
+    std::vector<uint8_t> wire_values(circuit.num_wires + 1, 0);
     
     // Set input values
     for (size_t i = 0; i < inputs.size(); ++i) {
@@ -940,6 +1635,237 @@ int CircuitUtils::bits_to_int(const std::vector<bool>& bits) {
     return value;
 }
 
+WireSlotPlan CircuitUtils::assign_wire_slots(const Circuit& circuit,
+                                             const std::vector<std::vector<size_t>>& levels,
+                                             const std::vector<size_t>& concurrent) {
+    constexpr int64_t NEVER = -1;
+    constexpr int64_t FOREVER = INT64_MAX;
+    
+    // Last schedule position reading each wire; outputs stay live to the end
+    std::vector<int64_t> last_use(circuit.num_wires + 1, NEVER);
+    int64_t pos = 0;
+    for (const auto& level : levels) {
+        for (size_t i : level) {
+            const auto& gate = circuit.gates[i];
+            last_use[gate.input_wire1] = pos;
+            if (gate.input_wire2 != -1) {
+                last_use[gate.input_wire2] = pos;
+            }
+            pos++;
+        }
+    }
+    for (int wire : circuit.output_wires) {
+        last_use[wire] = FOREVER;
+    }
+    
+    WireSlotPlan plan;
+    plan.gates = circuit.gates;
+    std::vector<int> slot_of(circuit.num_wires + 1, -1);
+    std::vector<int> free_slots;
+    auto allocate = [&](int wire) {
+        int slot;
+        if (free_slots.empty()) {
+            slot = static_cast<int>(plan.num_slots++);
+        } else {
+            slot = free_slots.back();
+            free_slots.pop_back();
+        }
+        slot_of[wire] = slot;
+        return slot;
+    };
+    // Slots freed by gates that run concurrently are held back until the whole
+    // group is done, so no gate of the group can be handed one of them
+    std::vector<int> held_slots;
+    bool holding = false;
+    auto release_if_dead = [&](int wire, int64_t at) {
+        if (last_use[wire] == at && slot_of[wire] != -1) {
+            (holding ? held_slots : free_slots).push_back(slot_of[wire]);
+            slot_of[wire] = -1;
+        }
+    };
+    
+    for (int wire : circuit.input_wires) {
+        plan.input_slots.push_back(allocate(wire));
+    }
+    for (int wire : circuit.input_wires) {
+        release_if_dead(wire, NEVER);
+    }
+    
+    // Allocate a gate's output before releasing its inputs, so the gate never
+    // overwrites a label it is still reading
+    pos = 0;
+    for (size_t l = 0; l < levels.size(); ++l) {
+        const auto& level = levels[l];
+        size_t group = l < concurrent.size() ? concurrent[l] : 0;
+        for (size_t k = 0; k < level.size(); ++k) {
+            if (k == group) {
+                free_slots.insert(free_slots.end(), held_slots.begin(), held_slots.end());
+                held_slots.clear();
+            }
+            holding = k < group;
+            size_t i = level[k];
+            const Gate& gate = circuit.gates[i];
+            Gate& slotted = plan.gates[i];
+            slotted.input_wire1 = slot_of[gate.input_wire1];
+            if (gate.input_wire2 != -1) {
+                slotted.input_wire2 = slot_of[gate.input_wire2];
+            }
+            slotted.output_wire = allocate(gate.output_wire);
+            
+            release_if_dead(gate.input_wire1, pos);
+            if (gate.input_wire2 != -1) {
+                release_if_dead(gate.input_wire2, pos);
+            }
+            release_if_dead(gate.output_wire, NEVER);
+            pos++;
+        }
+        free_slots.insert(free_slots.end(), held_slots.begin(), held_slots.end());
+        held_slots.clear();
+        holding = false;
+    }
+    
+    for (int wire : circuit.output_wires) {
+        plan.output_slots.push_back(slot_of[wire]);
+    }
+    return plan;
+}
+
+std::vector<std::vector<size_t>> CircuitUtils::topological_levels(const GarbledCircuit& gc) {
+    return topological_levels(gc, {gc.circuit.gates.size()});
+}
+
+std::vector<std::vector<size_t>> CircuitUtils::topological_levels(const GarbledCircuit& gc,
+                                                                  const std::vector<size_t>& chunk_ends) {
+    // Input wires sit at level 0; a non-free gate is one level above its latest input.
+    // Wires of earlier chunks count as sitting at the chunk's first level
+    std::vector<size_t> wire_level(gc.circuit.num_wires + 1, 0);
+    size_t base = 0;
+    auto level_of = [&wire_level, &base](int wire) -> size_t { return std::max(wire_level[wire], base); };
+    
+    std::vector<std::vector<size_t>> garbled_levels;
+    std::vector<std::vector<size_t>> free_levels;
+    size_t begin = 0;
+    for (size_t end : chunk_ends) {
+        base = garbled_levels.size();
+        for (size_t i = begin; i < end; ++i) {
+            const auto& gate = gc.circuit.gates[i];
+            size_t level = level_of(gate.input_wire1);
+            if (gate.input_wire2 != -1) {
+                level = std::max(level, level_of(gate.input_wire2));
+            }
+            bool is_free = gc.is_free_gate(gate.type);
+            if (!is_free) {
+                level++;
+            }
+            wire_level[gate.output_wire] = level;
+            
+            if (garbled_levels.size() <= level) {
+                garbled_levels.resize(level + 1);
+                free_levels.resize(level + 1);
+            }
+            (is_free ? free_levels : garbled_levels)[level].push_back(i);
+        }
+        begin = end;
+    }
+    
+    for (size_t l = 0; l < garbled_levels.size(); ++l) {
+        garbled_levels[l].insert(garbled_levels[l].end(), free_levels[l].begin(), free_levels[l].end());
+    }
+    return garbled_levels;
+}
+
+std::vector<size_t> CircuitUtils::stream_chunk_ends(const GarbledCircuit& gc, size_t chunk_bytes) {
+    const size_t num_gates = gc.circuit.gates.size();
+    std::vector<size_t> chunk_ends;
+    size_t chunk_start = 0;
+    for (size_t i = 0; i < num_gates; ++i) {
+        if (i > chunk_start && gc.table_offsets[i + 1] - gc.table_offsets[chunk_start] > chunk_bytes) {
+            chunk_ends.push_back(i);
+            chunk_start = i;
+        }
+    }
+    chunk_ends.push_back(num_gates);
+    return chunk_ends;
+}
+
+size_t CircuitUtils::chunk_levels_end(const std::vector<std::vector<size_t>>& levels,
+                                      size_t first_level, size_t chunk_end) {
+    // A chunk's levels run up to the first level holding a gate of a later chunk
+    size_t level = first_level;
+    while (level < levels.size() && (levels[level].empty() || levels[level].front() < chunk_end)) {
+        level++;
+    }
+    return level;
+}
+
+std::vector<size_t> CircuitUtils::table_gate_counts(const GarbledCircuit& gc,
+                                                    const std::vector<std::vector<size_t>>& levels) {
+    std::vector<size_t> counts;
+    counts.reserve(levels.size());
+    for (const auto& level : levels) {
+        counts.push_back(static_cast<size_t>(std::count_if(level.begin(), level.end(),
+            [&gc](size_t i) { return !gc.is_free_gate(gc.circuit.gates[i].type); })));
+    }
+    return counts;
+}
+
+void CircuitUtils::renumber_wires(Circuit& circuit) {
+    // Load-time only, so a hash map over the original (arbitrary) ids is fine
+    std::unordered_map<int, int> remap;
+    auto lookup = [&remap](int wire) {
+        auto it = remap.find(wire);
+        if (it == remap.end()) {
+            throw std::runtime_error("Circuit uses undefined wire: " + std::to_string(wire));
+        }
+        return it->second;
+    };
+    
+    int next = 1;
+    for (int& wire : circuit.input_wires) {
+        remap[wire] = next;
+        wire = next++;
+    }
+    for (auto& gate : circuit.gates) {
+        gate.input_wire1 = lookup(gate.input_wire1);
+        if (gate.input_wire2 != -1) {
+            gate.input_wire2 = lookup(gate.input_wire2);
+        }
+        remap[gate.output_wire] = next;
+        gate.output_wire = next++;
+    }
+    for (int& wire : circuit.output_wires) {
+        wire = lookup(wire);
+    }
+    circuit.num_wires = next - 1;
+}
+
+bool CircuitUtils::has_dense_wires(const Circuit& circuit) {
+    int num_inputs = static_cast<int>(circuit.input_wires.size());
+    if (circuit.num_wires != num_inputs + static_cast<int>(circuit.gates.size())) {
+        return false;
+    }
+    for (int i = 0; i < num_inputs; ++i) {
+        if (circuit.input_wires[i] != i + 1) return false;
+    }
+    for (size_t i = 0; i < circuit.gates.size(); ++i) {
+        const auto& gate = circuit.gates[i];
+        int id = num_inputs + 1 + static_cast<int>(i);
+        if (gate.output_wire != id) return false;
+        // Inputs must already be defined: 1 <= in < id
+        if (gate.input_wire1 < 1 || gate.input_wire1 >= id) return false;
+        // NOT has no second input, every other gate has one
+        if (gate.type == GateType::NOT) {
+            if (gate.input_wire2 != -1) return false;
+        } else if (gate.input_wire2 < 1 || gate.input_wire2 >= id) {
+            return false;
+        }
+    }
+    for (int wire : circuit.output_wires) {
+        if (wire < 1 || wire > circuit.num_wires) return false;
+    }
+    return true;
+}
+
 bool CircuitUtils::test_circuit_correctness(const Circuit& circuit, size_t num_tests) {
     LOG_INFO("Testing circuit correctness with " << num_tests << " random inputs");
     
@@ -1109,6 +2035,7 @@ namespace FileFormats {
         }
         
         file.close();
+        CircuitUtils::renumber_wires(circuit);
         return circuit;
     }
     
@@ -2,6 +2,7 @@
 
 #include "common.h"
 #include "crypto_utils.h"
+#include "thread_pool.h"
 #include <fstream>
 #include <sstream>
 #include <chrono>
@@ -100,12 +101,26 @@ private:
     Circuit merge_consecutive_gates(const Circuit& circuit);
 };
 
+/**
+ * Label slot assignment from a wire liveness pass (CircuitUtils::assign_wire_slots).
+ * A slot is handed back to the pool once the last gate reading its wire has run
+ * in schedule order, so label storage is bounded by the number of simultaneously
+ * live wires rather than by the total wire count.
+ */
+struct WireSlotPlan {
+    std::vector<Gate> gates;        // circuit.gates[i] reading and writing slots instead of wire ids
+    std::vector<int> input_slots;   // slot of circuit.input_wires[i]
+    std::vector<int> output_slots;  // slot of circuit.output_wires[i], never reused
+    size_t num_slots = 0;
+};
+
 /**
  * Garbler class - responsible for creating garbled circuits
  */
 class Garbler {
 public:
-    explicit Garbler(bool use_pandp = false);
+    explicit Garbler(bool use_pandp = false, bool use_free_xor = false,
+                     GarblingScheme scheme = GarblingScheme::STANDARD);
     ~Garbler() = default;
     
     /**
@@ -115,6 +130,28 @@ public:
     // Garble a circuit
     GarbledCircuit garble_circuit(const Circuit& circuit);
     
+    // Garble count independent instances of one circuit in a single pass. Each gate
+    // is decoded once for all of them and their hash queries, interleaved instance
+    // by instance, go through PRF_batch together. Every instance has its own delta,
+    // labels and tables, the same as from count garble_circuit() calls in a row
+    std::vector<GarbledCircuit> garble_circuits(const Circuit& circuit, size_t count);
+    
+    // The circuit description and table layout under this garbler's mode, without
+    // labels or tables
+    GarbledCircuit new_garbled_circuit(const Circuit& circuit) const;
+    
+    // Streaming garbling, in two steps. begin_streaming() fixes the schedule, cut
+    // into chunks of circuit order whose tables fill at most chunk_bytes (or one
+    // bigger table), and draws the labels: the returned circuit is marked streamed
+    // and its input labels can go out before any table exists.
+    // garble_circuit_streaming() then garbles chunk after chunk while a sender
+    // thread passes each finished one to send_chunk; at most queue_depth chunks
+    // wait for it. gc.tables stays empty and the output mapping is set at the end.
+    // An exception from send_chunk stops garbling and is rethrown
+    GarbledCircuit begin_streaming(const Circuit& circuit, size_t chunk_bytes);
+    void garble_circuit_streaming(GarbledCircuit& gc, size_t queue_depth,
+                                  const std::function<void(const uint8_t*, size_t)>& send_chunk);
+    
     // Get input encoding for garbler's inputs
     std::vector<WireLabel> encode_inputs(const GarbledCircuit& gc, 
                                        const std::vector<bool>& inputs,
@@ -135,6 +172,13 @@ public:
     std::vector<std::pair<WireLabel, WireLabel>> get_ot_input_pairs(
         const GarbledCircuit& gc, const std::vector<int>& wire_indices);
     
+    // Replace the OS-seeded PRG with a fixed seed (reproducible benchmark runs)
+    void set_seed(uint64_t seed);
+    
+    // Garble each level on num_threads threads (0 = one per hardware thread).
+    // The garbled circuit is the same for any thread count
+    void set_threads(size_t num_threads);
+    
     /**
      * Statistics and information
      */
@@ -146,24 +190,93 @@ public:
     void print_garbling_stats(const GarbledCircuit& gc);
 
 private:
-    std::map<int, std::pair<WireLabel, WireLabel>> wire_labels; // wire_id -> (label0, label1)
+    // Label state of one circuit instance being garbled
+    struct GarbleInstance {
+        std::vector<std::pair<WireLabel, WireLabel>> wire_labels; // slot -> (label0, label1)
+        WireLabel delta{}; // Global free-XOR offset, kept secret by the garbler
+    };
+    
+    std::vector<GarbleInstance> instances_; // One per instance garbled together (garble_circuits)
+    WireSlotPlan slots_; // Gates rewritten onto label slots for the circuit being garbled
+    std::vector<std::vector<size_t>> levels_; // Garbling schedule of that circuit
+    std::vector<size_t> level_table_gates_;   // Table gates heading each level, garbled in parallel
+    std::vector<size_t> stream_chunk_ends_;   // Chunk boundaries (gate indices) of a streamed circuit
     bool use_pandp_ = false;
+    bool use_free_xor_ = false;
+    GarblingScheme scheme_ = GarblingScheme::STANDARD;
+    AesCtrPrg prg_; // Deltas, input labels and the seeds of the per-gate substreams
+    std::unique_ptr<ThreadPool> pool_;
+    
+    // Scratch state of one garbling thread
+    struct GarbleWorker {
+        std::vector<HashQuery> queries;
+        std::vector<size_t> offsets;
+        std::vector<WireLabel> hashes;
+        // One per instance, seeded with its gate seed; seeks to each gate's substream
+        std::vector<std::unique_ptr<AesCtrPrg>> prgs;
+    };
+    
+    std::vector<std::unique_ptr<GarbleWorker>> workers_; // One per pool thread
+    
+    // Plan label slots for the schedule once, then label the inputs of the count
+    // instances gcs and seed the workers
+    void start_garbling(GarbledCircuit* gcs, size_t count, std::vector<std::vector<size_t>> levels);
+    
+    // Garble levels [first, last) of the schedule, instance k into windows[k], a
+    // buffer holding its table arena from byte window_start on (the whole arena,
+    // or a streamed chunk). gc gives the table layout, the same for all instances
+    void garble_levels(const GarbledCircuit& gc, size_t first, size_t last,
+                       uint8_t* const* windows, size_t window_start);
+    
+    // Output mappings from the labels of the output slots
+    void finish_garbling(GarbledCircuit* gcs, size_t count);
+    
+    // Label the input wires of one instance, drawing its delta first
+    void generate_wire_labels(GarbledCircuit& gc, GarbleInstance& instance);
     
-    // Core garbling functions
-    GarbledGate garble_gate(const Gate& gate, int gate_id);
+    // Garble count gates of one level (indices in gates) on one thread for every
+    // instance: hash them a batch at a time, then write each table into windows
+    void garble_gates(const GarbledCircuit& gc, const size_t* gates, size_t count, GarbleWorker& worker,
+                      uint8_t* const* windows, size_t window_start);
+    
+    // Core garbling functions; hashes holds the results of gate_hash_queries() for the gate
+    // and the rows are written in place into table, the gate's slice of GarbledCircuit::tables
+    void garble_gate(GarbledGate table, const Gate& gate, const WireLabel* hashes,
+                     GarbleInstance& instance, AesCtrPrg& prg);
     void assign_wire_labels(const Circuit& circuit);
     
+    // Append the hash queries garbling the gate needs (none for free gates), so that
+    // a whole window of gates can be hashed with one CryptoUtils::PRF_batch call
+    void gate_hash_queries(const Gate& gate, int gate_id, const GarbleInstance& instance,
+                           std::vector<HashQuery>& queries);
+    
     // Gate-specific garbling
-    GarbledGate garble_and_gate(const Gate& gate, int gate_id);
-    GarbledGate garble_or_gate(const Gate& gate, int gate_id);
-    GarbledGate garble_xor_gate(const Gate& gate, int gate_id);
-    GarbledGate garble_nand_gate(const Gate& gate, int gate_id);
-    GarbledGate garble_not_gate(const Gate& gate, int gate_id);
+    void garble_and_gate(GarbledGate table, const Gate& gate, const WireLabel* hashes,
+                         GarbleInstance& instance, AesCtrPrg& prg);
+    void garble_or_gate(GarbledGate table, const Gate& gate, const WireLabel* hashes,
+                        GarbleInstance& instance, AesCtrPrg& prg);
+    void garble_xor_gate(GarbledGate table, const Gate& gate, const WireLabel* hashes,
+                         GarbleInstance& instance, AesCtrPrg& prg);
+    void garble_nand_gate(GarbledGate table, const Gate& gate, const WireLabel* hashes,
+                          GarbleInstance& instance, AesCtrPrg& prg);
+    void garble_not_gate(GarbledGate table, const Gate& gate, const WireLabel* hashes,
+                         GarbleInstance& instance, AesCtrPrg& prg);
+    
+    // Half-gates garbling of AND, OR and NAND (two ciphertexts, no randomness)
+    void garble_half_gate(GarbledGate table, const Gate& gate, const WireLabel* hashes,
+                          GarbleInstance& instance);
+    
+    // Three-halves garbling of AND, OR and NAND (three half-ciphertexts + control bits)
+    void garble_three_halves_gate(GarbledGate table, const Gate& gate, const WireLabel* hashes,
+                                  GarbleInstance& instance, AesCtrPrg& prg);
     
     // Helper functions
-    void generate_garbled_table(GarbledGate& garbled_gate,
+    // row_hashes[a*2+b] = H(in1 label a, in2 label b, gate_id)
+    void generate_garbled_table(GarbledGate table,
                               const Gate& gate, 
-                              int gate_id,
+                              const WireLabel* row_hashes,
+                              GarbleInstance& instance,
+                              AesCtrPrg& prg,
                               const WireLabel& out_label0,
                               const WireLabel& out_label1,
                               const WireLabel& in1_label0,
@@ -171,7 +284,21 @@ private:
                               const WireLabel& in2_label0 = {},
                               const WireLabel& in2_label1 = {});
     
-    void permute_garbled_table(GarbledGate& garbled_gate);
+    // GRR3 (point-and-permute): derive the output labels so that row 0 need not be sent
+    void derive_grr3_output_labels(const Gate& gate,
+                                 const WireLabel* row_hashes,
+                                 GarbleInstance& instance,
+                                 AesCtrPrg& prg,
+                                 const WireLabel& in1_label0,
+                                 const WireLabel& in2_label0,
+                                 WireLabel& out_label0,
+                                 WireLabel& out_label1);
+    
+    void permute_garbled_table(GarbledGate table, AesCtrPrg& prg);
+    std::pair<WireLabel, WireLabel> make_label_pair(const GarbleInstance& instance, AesCtrPrg& prg);
+    
+    // Labels of a table gate's output: fresh ones, unless GRR3 derives them from the row hashes
+    const std::pair<WireLabel, WireLabel>& output_labels(const Gate& gate, GarbleInstance& instance, AesCtrPrg& prg);
     static inline uint8_t perm_bit(const WireLabel& lbl) { return lbl[WIRE_LABEL_SIZE - 1] & 0x01; }
 };
 
@@ -180,7 +307,8 @@ private:
  */
 class Evaluator {
 public:
-    explicit Evaluator(bool use_pandp = false);
+    explicit Evaluator(bool use_pandp = false, bool use_free_xor = false,
+                       GarblingScheme scheme = GarblingScheme::STANDARD);
     ~Evaluator() = default;
     
     /**
@@ -191,6 +319,17 @@ public:
     std::vector<WireLabel> evaluate_circuit(const GarbledCircuit& gc,
                                           const std::vector<WireLabel>& input_labels);
     
+    // Streaming evaluation of gc (from ProtocolManager::receive_circuit_description,
+    // no tables): receive_chunk(buffer, size) fills buffer with the next size bytes
+    // of the table arena. A receiver thread reads chunks of at most chunk_bytes (or
+    // one bigger table) up to queue_depth ahead, and each chunk's gates are
+    // evaluated as soon as it is in and then dropped. An exception from
+    // receive_chunk is rethrown
+    std::vector<WireLabel> evaluate_circuit_streaming(const GarbledCircuit& gc,
+                                                      const std::vector<WireLabel>& input_labels,
+                                                      size_t chunk_bytes, size_t queue_depth,
+                                                      const std::function<void(uint8_t*, size_t)>& receive_chunk);
+    
     // Evaluate with mixed inputs (some labels, some plaintext for testing)
     std::vector<WireLabel> evaluate_with_mixed_inputs(const GarbledCircuit& gc,
                                                     const std::vector<WireLabel>& garbler_labels,
@@ -201,13 +340,13 @@ public:
      */
     
     // Evaluate a single garbled gate
-    WireLabel evaluate_gate(const GarbledGate& garbled_gate,
+    WireLabel evaluate_gate(ConstGarbledGate garbled_gate,
                           const WireLabel& input1_label,
                           const WireLabel& input2_label,
                           int gate_id);
     
     // Evaluate unary gate (like NOT)
-    WireLabel evaluate_unary_gate(const GarbledGate& garbled_gate,
+    WireLabel evaluate_unary_gate(ConstGarbledGate garbled_gate,
                                 const WireLabel& input_label,
                                 int gate_id);
     
@@ -225,25 +364,106 @@ public:
         int successful_decryptions = 0;
         int cipher_decryptions = 0;
         std::chrono::microseconds total_time{0};
+        
+        // Add the gate counters of another thread (not the time)
+        void merge(const EvaluationStats& other) {
+            gates_evaluated += other.gates_evaluated;
+            decryption_attempts += other.decryption_attempts;
+            successful_decryptions += other.successful_decryptions;
+            cipher_decryptions += other.cipher_decryptions;
+        }
     };
     
     EvaluationStats get_evaluation_stats() const { return eval_stats; }
     void reset_stats() { eval_stats = {}; }
+    
+    // Evaluate each level on num_threads threads (0 = one per hardware thread).
+    // Output labels and statistics are the same for any thread count
+    void set_threads(size_t num_threads);
 
 private:
     EvaluationStats eval_stats;
-    std::map<int, WireLabel> wire_values; // wire_id -> current label
+    std::vector<WireLabel> wire_values; // slot -> current label (see WireSlotPlan)
     bool use_pandp_ = false;
+    bool use_free_xor_ = false;
+    GarblingScheme scheme_ = GarblingScheme::STANDARD;
+    std::unique_ptr<ThreadPool> pool_;
+    WireSlotPlan slots_; // Gates rewritten onto label slots for the circuit being evaluated
+    std::vector<std::vector<size_t>> levels_; // Evaluation schedule of that circuit
+    std::vector<size_t> level_table_gates_;   // Table gates heading each level, evaluated in parallel
+    
+    // Scratch state and statistics of one evaluation thread
+    struct EvalWorker {
+        std::vector<HashQuery> queries;
+        std::vector<size_t> offsets;
+        std::vector<WireLabel> hashes;
+        EvaluationStats stats;
+    };
+    
+    std::vector<std::unique_ptr<EvalWorker>> workers_; // One per pool thread
+    
+    // Check the circuit and inputs, plan label slots for the schedule, load the
+    // input labels and reset the workers
+    void start_evaluation(const GarbledCircuit& gc, const std::vector<WireLabel>& input_labels,
+                          std::vector<std::vector<size_t>> levels);
+    
+    // Evaluate levels [first, last) of the schedule reading tables from window, a
+    // buffer holding the table arena from byte window_start on
+    void evaluate_levels(const GarbledCircuit& gc, size_t first, size_t last,
+                         const uint8_t* window, size_t window_start);
+    
+    // Merge the worker stats and collect the output labels
+    std::vector<WireLabel> finish_evaluation(const GarbledCircuit& gc,
+                                             std::chrono::high_resolution_clock::time_point start_time);
+    
+    // Evaluate count gates of one level (indices in gates) on one thread: hash them a
+    // batch at a time, then finish each gate and store its output label
+    void evaluate_gates(const GarbledCircuit& gc, const size_t* gates, size_t count, EvalWorker& worker,
+                        const uint8_t* window, size_t window_start);
     
     // Core evaluation functions
-    WireLabel try_decrypt_gate(const GarbledGate& garbled_gate,
-                             const WireLabel& input1,
-                             const WireLabel& input2,
-                             int gate_id);
+    // Classic (no point-and-permute) tables: every row is keyed by the gate's one
+    // hash, H(in1, in2, gate_id) or H(in, 0, gate_id) for unary gates
+    WireLabel try_decrypt_gate(ConstGarbledGate garbled_gate,
+                             const WireLabel& hash,
+                             int gate_id,
+                             EvaluationStats& stats);
+    
+    // Append the hash queries evaluating a binary gate needs, in the order
+    // evaluate_gate() consumes them; unary gates need H(input, 0, gate_id)
+    void binary_gate_queries(const WireLabel& input1_label,
+                             const WireLabel& input2_label,
+                             int gate_id,
+                             std::vector<HashQuery>& queries);
+    
+    // Gate evaluation from precomputed hashes (one PRF_batch per topological level),
+    // counting into the calling thread's stats
+    WireLabel evaluate_gate(ConstGarbledGate garbled_gate,
+                          const WireLabel& input1_label,
+                          const WireLabel& input2_label,
+                          int gate_id,
+                          const WireLabel* hashes,
+                          EvaluationStats& stats);
     
-    WireLabel try_decrypt_unary_gate(const GarbledGate& garbled_gate,
-                                   const WireLabel& input,
-                                   int gate_id);
+    WireLabel evaluate_unary_gate(ConstGarbledGate garbled_gate,
+                                const WireLabel& input_label,
+                                int gate_id,
+                                const WireLabel& hash,
+                                EvaluationStats& stats);
+    
+    // Half-gates evaluation: two hash calls, no trial decryption
+    WireLabel evaluate_half_gate(ConstGarbledGate garbled_gate,
+                               const WireLabel& input1_label,
+                               const WireLabel& input2_label,
+                               const WireLabel* hashes,
+                               EvaluationStats& stats);
+    
+    // Three-halves evaluation: three hash calls, no trial decryption
+    WireLabel evaluate_three_halves_gate(ConstGarbledGate garbled_gate,
+                                       const WireLabel& input1_label,
+                                       const WireLabel& input2_label,
+                                       const WireLabel* hashes,
+                                       EvaluationStats& stats);
     
     // Helper functions
     bool is_valid_gate_output(const std::vector<uint8_t>& decrypted_data);
@@ -275,6 +495,50 @@ public:
     static std::vector<bool> int_to_bits(int value, int bit_width);
     static int bits_to_int(const std::vector<bool>& bits);
     
+    // Renumber wires densely: inputs become 1..num_inputs, gate i's output becomes
+    // num_inputs + 1 + i and every reference follows (a wire written twice maps to
+    // its latest writer). Sets num_wires; throws on a use of an undefined wire
+    static void renumber_wires(Circuit& circuit);
+    
+    // True if the circuit already has the numbering renumber_wires() produces and
+    // every gate has exactly the inputs its type takes
+    static bool has_dense_wires(const Circuit& circuit);
+    
+    // Liveness pass: rewrite the gates onto a reusable pool of label slots for the
+    // given schedule (the gate order of the levels, flattened). A gate's output
+    // never shares a slot with its own inputs; output wires are never reused.
+    // The first concurrent[l] gates of level l may run in parallel: none of them
+    // reuses a slot another one reads or writes. Requires dense wires
+    static WireSlotPlan assign_wire_slots(const Circuit& circuit,
+                                          const std::vector<std::vector<size_t>>& levels,
+                                          const std::vector<size_t>& concurrent = {});
+    
+    // Group gate indices into topological levels. A non-free gate only reads wires
+    // of earlier levels; free gates join the level of their latest input and are
+    // listed after the level's non-free gates, in circuit order
+    static std::vector<std::vector<size_t>> topological_levels(const GarbledCircuit& gc);
+    
+    // Same, for gates processed in chunks [chunk_ends[c-1], chunk_ends[c]) of circuit
+    // order (the last end is the gate count): the levels of a chunk follow those of
+    // the previous one, so a prefix of the levels covers a prefix of the gates.
+    // Levels may be empty
+    static std::vector<std::vector<size_t>> topological_levels(const GarbledCircuit& gc,
+                                                               const std::vector<size_t>& chunk_ends);
+    
+    // Stream chunks: runs of circuit order whose tables fill at most chunk_bytes (a
+    // bigger table gets a chunk of its own), as the end gate index of each run
+    static std::vector<size_t> stream_chunk_ends(const GarbledCircuit& gc, size_t chunk_bytes);
+    
+    // With levels from topological_levels(gc, chunk_ends): one past the last level
+    // of the chunk ending at gate chunk_end, whose levels start at first_level
+    static size_t chunk_levels_end(const std::vector<std::vector<size_t>>& levels,
+                                   size_t first_level, size_t chunk_end);
+    
+    // Number of table (non-free) gates heading each level: the gates a level can
+    // process in parallel
+    static std::vector<size_t> table_gate_counts(const GarbledCircuit& gc,
+                                                 const std::vector<std::vector<size_t>>& levels);
+    
     // Circuit testing
     static bool test_circuit_correctness(const Circuit& circuit, 
                                        size_t num_tests = 100);
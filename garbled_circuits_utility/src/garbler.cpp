@@ -2,6 +2,7 @@
 #include "garbled_circuit.h"
 #include "socket_utils.h"
 #include "ot_handler.h"
+#include "garbling_pool.h"
 #include <iostream>
 #include <fstream>
 #include <getopt.h>
@@ -9,8 +10,8 @@
 
 /**
  * Responsibilities:
- * 1. Load and garble the circuit
- * 2. Listen for evaluator connection
+ * 1. Load and garble the circuit (or keep a pool of pre-garbled instances)
+ * 2. Listen for evaluator connections, one session each
  * 3. Send garbled circuit to evaluator
  * 4. Perform OT for evaluator's inputs
  * 5. Receive and display final result
@@ -25,6 +26,10 @@ public:
                 return 1;
             }
                         
+            if (io_uring) {
+                SocketUtils::set_transport(TransportBackend::IO_URING);
+            }
+            
             auto t0 = std::chrono::high_resolution_clock::now();
             // Load circuit
             auto circuit = load_circuit();
@@ -35,23 +40,68 @@ public:
             // Parse garbler inputs
             auto garbler_inputs = parse_inputs();
             
-            // Garble circuit
-            auto tg0 = std::chrono::high_resolution_clock::now();
-            Garbler garbler(use_pandp);
-            auto garbled_circuit = garbler.garble_circuit(circuit);
-            auto tg1 = std::chrono::high_resolution_clock::now();
-            auto garble_ms = std::chrono::duration_cast<std::chrono::milliseconds>(tg1 - tg0).count();
-            std::cout << "[TIME] Garbled circuit in " << garble_ms << " ms" << std::endl;
-            
-            // Set up network connection
-            auto connection = std::make_unique<SocketConnection>(port);
-            connection->wait_for_client();
+            if (use_seed) {
+                LOG_WARNING("Using fixed PRG seed " << seed << "; labels are predictable");
+            }
             
-            auto protocol = ProtocolManager(std::move(connection));
+            // With a pool, a background garbler keeps fresh instances ready so a
+            // session starts as soon as the evaluator connects
+            std::unique_ptr<GarblingPool> garbling_pool;
+            if (pool_size > 0) {
+                garbling_pool = std::make_unique<GarblingPool>(make_garbler(), circuit, pool_size);
+                std::cout << "Pre-garbling up to " << pool_size << " instances in the background" << std::endl;
+            }
+            auto garbler = make_garbler();
             
-            // Protocol execution
-            execute_protocol(protocol, garbled_circuit, garbler, garbler_inputs);
+            auto listener = std::make_unique<SocketConnection>(port);
+            int failed_sessions = 0;
+            for (size_t session = 1; num_sessions == 0 || session <= num_sessions; ++session) {
+                GarbledCircuit garbled_circuit;
+                if (!garbling_pool) {
+                    garbled_circuit = garble(*garbler, circuit);
+                }
+                
+                // Set up network connection
+                auto connection = listener->accept_connection();
+                if (num_sessions != 1) {
+                    std::cout << "\n=== SESSION " << session << " ===" << std::endl;
+                }
+                
+                try {
+                    if (garbling_pool) {
+                        auto tp0 = std::chrono::high_resolution_clock::now();
+                        size_t ready = garbling_pool->ready();
+                        garbled_circuit = garbling_pool->take();
+                        auto tp1 = std::chrono::high_resolution_clock::now();
+                        std::cout << "[TIME] Took pre-garbled circuit (" << ready << " of " << pool_size
+                                  << " ready) in "
+                                  << std::chrono::duration_cast<std::chrono::milliseconds>(tp1 - tp0).count()
+                                  << " ms" << std::endl;
+                    }
+                    
+                    auto protocol = ProtocolManager(std::move(connection));
+                    if (zerocopy && !protocol.enable_zerocopy()) {
+                        LOG_WARNING("MSG_ZEROCOPY is not supported here; sending with copies");
+                    }
+                    
+                    // Protocol execution
+                    execute_protocol(protocol, garbled_circuit, *garbler, garbler_inputs);
+                } catch (const GarblerException&) {
+                    throw; // Garbling or the garbler's inputs are broken; later sessions would fail too
+                } catch (const std::exception& e) {
+                    // A failed session only ends that evaluator's connection
+                    if (num_sessions == 1) {
+                        throw;
+                    }
+                    std::cerr << "Session " << session << " failed: " << e.what() << std::endl;
+                    failed_sessions++;
+                }
+            }
             
+            if (failed_sessions > 0) {
+                std::cerr << failed_sessions << " of " << num_sessions << " sessions failed" << std::endl;
+                return 1;
+            }
             std::cout << "Protocol completed successfully!" << std::endl;
             return 0;
             
@@ -66,6 +116,17 @@ private:
     std::string input_string;
     int port;
     bool use_pandp = false;
+    bool use_free_xor = false;
+    GarblingScheme scheme = GarblingScheme::STANDARD;
+    bool use_seed = false;
+    uint64_t seed = 0;
+    size_t num_threads = 1;
+    bool stream = false;
+    size_t pool_size = 0;    // Pre-garbled instances kept ready; 0 = garble per session
+    size_t num_sessions = 1; // Evaluator sessions to serve; 0 = until killed
+    bool zerocopy = false;
+    bool io_uring = false;
+    size_t num_stripes = 0;  // Data connections the tables are striped over; 0 = the control connection
     
     
     bool parse_arguments(int argc, char* argv[]) {
@@ -74,13 +135,24 @@ private:
             {"circuit", required_argument, 0, 'c'},
             {"input", required_argument, 0, 'i'},
             {"pandp", no_argument, 0, 0},
+            {"free-xor", no_argument, 0, 0},
+            {"half-gates", no_argument, 0, 0},
+            {"three-halves", no_argument, 0, 0},
+            {"seed", required_argument, 0, 's'},
+            {"threads", required_argument, 0, 't'},
+            {"stream", no_argument, 0, 0},
+            {"pool", required_argument, 0, 0},
+            {"sessions", required_argument, 0, 0},
+            {"zerocopy", no_argument, 0, 0},
+            {"io-uring", no_argument, 0, 0},
+            {"stripes", required_argument, 0, 0},
             {0, 0, 0, 0}
         };
         
         int opt;
         int option_index = 0;
         
-        while ((opt = getopt_long(argc, argv, "p:c:i:", long_options, &option_index)) != -1) {
+        while ((opt = getopt_long(argc, argv, "p:c:i:s:t:", long_options, &option_index)) != -1) {
             switch (opt) {
                 case 'p':
                     port = std::stoi(optarg);
@@ -91,9 +163,41 @@ private:
                 case 'i':
                     input_string = optarg;
                     break;
+                case 's':
+                    seed = std::stoull(optarg);
+                    use_seed = true;
+                    break;
+                case 't':
+                    // 0 = one thread per hardware thread
+                    num_threads = std::stoul(optarg);
+                    break;
                 case 0:
                     if (std::string(long_options[option_index].name) == "pandp") {
                         use_pandp = true;
+                    } else if (std::string(long_options[option_index].name) == "free-xor") {
+                        use_free_xor = true;
+                    } else if (std::string(long_options[option_index].name) == "half-gates") {
+                        // Half-gates builds on free-XOR and point-and-permute
+                        scheme = GarblingScheme::HALF_GATES;
+                        use_pandp = true;
+                        use_free_xor = true;
+                    } else if (std::string(long_options[option_index].name) == "three-halves") {
+                        // Three-halves has the same requirements as half-gates
+                        scheme = GarblingScheme::THREE_HALVES;
+                        use_pandp = true;
+                        use_free_xor = true;
+                    } else if (std::string(long_options[option_index].name) == "stream") {
+                        stream = true;
+                    } else if (std::string(long_options[option_index].name) == "pool") {
+                        pool_size = std::stoul(optarg);
+                    } else if (std::string(long_options[option_index].name) == "sessions") {
+                        num_sessions = std::stoul(optarg);
+                    } else if (std::string(long_options[option_index].name) == "zerocopy") {
+                        zerocopy = true;
+                    } else if (std::string(long_options[option_index].name) == "io-uring") {
+                        io_uring = true;
+                    } else if (std::string(long_options[option_index].name) == "stripes") {
+                        num_stripes = std::stoul(optarg);
                     }
                     break;
                 default:
@@ -106,9 +210,45 @@ private:
             return false;
         }
         
+        if (num_stripes > MAX_STRIPES) {
+            std::cerr << "Error: --stripes must be at most " << MAX_STRIPES << std::endl;
+            return false;
+        }
+        
+        if (stream && pool_size > 0) {
+            // Streamed tables are garbled online, while they are sent
+            std::cerr << "Error: --stream and --pool cannot be combined" << std::endl;
+            return false;
+        }
+        
         return true;
     }
     
+    std::unique_ptr<Garbler> make_garbler() {
+        auto garbler = std::make_unique<Garbler>(use_pandp, use_free_xor, scheme);
+        if (use_seed) {
+            // Fixed PRG seed: identical labels and tables across runs (benchmarks only).
+            // Instances garbled one after another still differ
+            garbler->set_seed(seed);
+        }
+        garbler->set_threads(num_threads);
+        return garbler;
+    }
+    
+    // Garble for one session; streamed circuits only get their labels here, the
+    // tables are garbled while they are sent
+    GarbledCircuit garble(Garbler& garbler, const Circuit& circuit) {
+        if (stream) {
+            return garbler.begin_streaming(circuit, STREAM_CHUNK_BYTES);
+        }
+        auto tg0 = std::chrono::high_resolution_clock::now();
+        GarbledCircuit gc = garbler.garble_circuit(circuit);
+        auto tg1 = std::chrono::high_resolution_clock::now();
+        auto garble_ms = std::chrono::duration_cast<std::chrono::milliseconds>(tg1 - tg0).count();
+        std::cout << "[TIME] Garbled circuit in " << garble_ms << " ms" << std::endl;
+        return gc;
+    }
+    
     
     Circuit load_circuit() {
         GarbledCircuitManager manager;
@@ -136,7 +276,7 @@ private:
     }
     
     void execute_protocol(ProtocolManager& protocol, 
-                         const GarbledCircuit& gc,
+                         GarbledCircuit& gc,
                          Garbler& garbler,
                          const std::vector<bool>& garbler_inputs) {
         
@@ -144,6 +284,9 @@ private:
         protocol.send_hello("Garbler");
         std::string evaluator_name = protocol.receive_hello();
         std::cout << "Connected to: " << evaluator_name << std::endl;
+        if (num_stripes > 0) {
+            protocol.open_stripes(num_stripes);
+        }
         
         // Display protocol information
         std::cout << "\n=== GARBLED CIRCUIT PROTOCOL ===" << std::endl;
@@ -153,11 +296,21 @@ private:
         }
         std::cout << " (decimal: " << CircuitUtils::bits_to_int(garbler_inputs) << ")" << std::endl;
         if (use_pandp) std::cout << "Point-and-Permute: ENABLED" << std::endl;
+        if (use_free_xor) std::cout << "Free-XOR: ENABLED" << std::endl;
+        if (scheme == GarblingScheme::HALF_GATES) std::cout << "Half-Gates: ENABLED" << std::endl;
+        if (scheme == GarblingScheme::THREE_HALVES) std::cout << "Three-Halves: ENABLED" << std::endl;
+        std::cout << "AES backend: " << CryptoUtils::aes_backend_name(CryptoUtils::aes_backend()) << std::endl;
+        std::cout << "Transport: " << SocketUtils::transport_name(SocketUtils::transport()) << std::endl;
         
         // Step 1: Send garbled circuit
     std::cout << "\n[STEP 1] Sending garbled circuit to evaluator..." << std::endl;
     auto s0 = std::chrono::high_resolution_clock::now();
-    protocol.send_circuit(gc);
+    if (stream) {
+        // The tables follow the inputs, see below
+        protocol.send_circuit_description(gc);
+    } else {
+        protocol.send_circuit(gc);
+    }
     auto s1 = std::chrono::high_resolution_clock::now();
     std::cout << "           Done in "
           << std::chrono::duration_cast<std::chrono::milliseconds>(s1 - s0).count()
@@ -193,6 +346,21 @@ private:
                       << " ms" << std::endl;
         }
         
+        // Streaming: with its inputs in hand the evaluator consumes each chunk of
+        // tables as soon as it is garbled and sent
+        if (stream) {
+            std::cout << "[STREAM] Garbling and streaming tables to evaluator..." << std::endl;
+            auto st0 = std::chrono::high_resolution_clock::now();
+            garbler.garble_circuit_streaming(gc, STREAM_QUEUE_DEPTH,
+                                             [&protocol](const uint8_t* data, size_t size) {
+                                                 protocol.send_table_chunk(data, size);
+                                             });
+            auto st1 = std::chrono::high_resolution_clock::now();
+            std::cout << "           Garbled and streamed " << gc.table_bytes() << " bytes of tables in "
+                      << std::chrono::duration_cast<std::chrono::milliseconds>(st1 - st0).count()
+                      << " ms" << std::endl;
+        }
+        
         // Step 4: Receive result
         std::cout << "[STEP 4] Waiting for evaluation result..." << std::endl;
         
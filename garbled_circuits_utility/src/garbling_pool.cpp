@@ -0,0 +1,77 @@
+#include "garbling_pool.h"
+#include <algorithm>
+
+GarblingPool::GarblingPool(std::unique_ptr<Garbler> garbler, Circuit circuit, size_t capacity)
+    : garbler_(std::move(garbler)), circuit_(std::move(circuit)), capacity_(capacity == 0 ? 1 : capacity) {
+    if (!garbler_) {
+        throw GarblerException("Garbling pool needs a garbler");
+    }
+    refiller_ = std::thread(&GarblingPool::refill_loop, this);
+}
+
+GarblingPool::~GarblingPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    not_full_.notify_all();
+    // An instance being garbled is finished first, then dropped
+    refiller_.join();
+}
+
+GarbledCircuit GarblingPool::take() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this] { return error_ || !ready_.empty(); });
+    if (ready_.empty()) {
+        std::rethrow_exception(error_);
+    }
+
+    // Moved out, so no later session can get the same labels
+    GarbledCircuit gc = std::move(ready_.front());
+    ready_.pop_front();
+    not_full_.notify_one();
+    return gc;
+}
+
+size_t GarblingPool::ready() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ready_.size();
+}
+
+size_t GarblingPool::garbled() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return garbled_;
+}
+
+void GarblingPool::refill_loop() {
+    for (;;) {
+        size_t count;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_full_.wait(lock, [this] { return stopping_ || ready_.size() < capacity_; });
+            if (stopping_) {
+                return;
+            }
+            count = std::min(capacity_ - ready_.size(), POOL_GARBLE_LANES);
+        }
+
+        // Garble the missing instances together, without the lock so sessions
+        // can take ready ones meanwhile
+        std::vector<GarbledCircuit> gcs;
+        try {
+            gcs = garbler_->garble_circuits(circuit_, count);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            error_ = std::current_exception();
+            not_empty_.notify_all();
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& gc : gcs) {
+            ready_.push_back(std::move(gc));
+        }
+        garbled_ += gcs.size();
+        not_empty_.notify_all();
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "common.h"
+#include "garbled_circuit.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+/**
+ * Offline pre-garbling: keeps up to capacity fresh garbled instances of one
+ * circuit in memory, garbled ahead of time on a background thread, up to
+ * POOL_GARBLE_LANES at a time. take() hands an instance out and the thread
+ * garbles a replacement, so a session only pays for transfer, OT and
+ * evaluation. Every instance has its own labels and delta and is given out
+ * exactly once.
+ */
+class GarblingPool {
+public:
+    // The pool's garbler garbles only on the background thread; set its seed
+    // and thread count before handing it over
+    GarblingPool(std::unique_ptr<Garbler> garbler, Circuit circuit, size_t capacity);
+    ~GarblingPool();
+
+    GarblingPool(const GarblingPool&) = delete;
+    GarblingPool& operator=(const GarblingPool&) = delete;
+
+    // Remove a garbled instance, waiting for one if the pool is empty. Rethrows
+    // the error if garbling failed
+    GarbledCircuit take();
+
+    // Instances ready right now
+    size_t ready() const;
+
+    size_t capacity() const { return capacity_; }
+
+    // Instances garbled so far, including those handed out
+    size_t garbled() const;
+
+private:
+    void refill_loop();
+
+    std::unique_ptr<Garbler> garbler_;
+    Circuit circuit_;
+    size_t capacity_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+    std::deque<GarbledCircuit> ready_;
+    size_t garbled_ = 0;
+    bool stopping_ = false;
+    std::exception_ptr error_;
+    std::thread refiller_;
+};
@@ -9,16 +9,13 @@
 
 using namespace osuCrypto;
 
+// block and WireLabel are both an __m128i, so these are register moves
 block OTHandler::wire_label_to_block(const WireLabel& label) {
-    block b{};
-    std::memcpy(&b, label.data(), std::min<size_t>(16, label.size()));
-    return b;
+    return block(label.vec());
 }
 
 WireLabel OTHandler::block_to_wire_label(const block& b) {
-    WireLabel wl{0};
-    std::memcpy(wl.data(), &b, std::min(sizeof(block), wl.size()));
-    return wl;
+    return WireLabel(b.mData);
 }
 
 OTHandler::OTHandler()
@@ -158,9 +155,7 @@ void OTHandler::kdf_mask_labels(const std::vector<std::pair<WireLabel,WireLabel>
             WireLabel mask{};
             sha256_block_mask(otBlocks[i][bit], 0xA5, i, (uint8_t)bit, mask.data(), mask.size());
             const WireLabel& src = (bit == 0 ? in[i].first : in[i].second);
-            for (size_t j=0;j<mask.size();++j){
-                masked[i][bit][j] = src[j] ^ mask[j];
-            }
+            masked[i][bit] = src ^ mask;
         }
     }
 }
@@ -175,8 +170,6 @@ void OTHandler::derive_chosen_labels(const std::vector<std::array<WireLabel,2>>&
         bool c = choices[i];
         WireLabel mask{};
         sha256_block_mask(recvBlocks[i], 0xA5, i, (uint8_t)c, mask.data(), mask.size());
-        for(size_t j=0;j<mask.size();++j){
-            out[i][j] = masked[i][c][j] ^ mask[j];
-        }
+        out[i] = masked[i][c] ^ mask;
     }
 }
\ No newline at end of file
@@ -1,10 +1,101 @@
 #include "socket_utils.h"
+#include "uring_transport.h"
+#include "crypto_utils.h"
 #include <cstring>
 #include <stdexcept>
 #include <errno.h>
 #include <sstream>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <chrono>
+#include <exception>
+#include <thread>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
 
-int SocketUtils::create_server_socket(int port) {
+namespace {
+
+// Big-endian 32-bit field; the caller has checked the bounds
+inline uint32_t load_be32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+inline void store_be32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; ++i) {
+        p[i] = static_cast<uint8_t>(v >> (24 - 8 * i));
+    }
+}
+
+inline uint64_t load_be64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+inline void store_be64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; ++i) {
+        p[i] = static_cast<uint8_t>(v >> (56 - 8 * i));
+    }
+}
+
+// Run work(0) .. work(count - 1) on threads of their own (work(0) on the
+// caller) and rethrow the first error once all have finished
+void run_per_stripe(size_t count, const std::function<void(size_t)>& work) {
+    std::vector<std::exception_ptr> errors(count);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < count; ++i) {
+        threads.emplace_back([&work, &errors, i] {
+            try {
+                work(i);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    try {
+        work(0);
+    } catch (...) {
+        errors[0] = std::current_exception();
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+// GC_TRANSPORT=posix|io_uring overrides the POSIX default
+TransportBackend detect_transport() {
+    if (const char* env = std::getenv("GC_TRANSPORT")) {
+        std::string name(env);
+        if (name == "posix") return TransportBackend::POSIX;
+        if (name == "io_uring") {
+            if (!SocketUtils::transport_supported(TransportBackend::IO_URING)) {
+                throw NetworkException("Transport not supported by this kernel: io_uring");
+            }
+            return TransportBackend::IO_URING;
+        }
+        throw NetworkException("Unknown GC_TRANSPORT: " + name);
+    }
+    return TransportBackend::POSIX;
+}
+
+TransportBackend& active_transport() {
+    static TransportBackend backend = detect_transport();
+    return backend;
+}
+
+} // namespace
+
+int SocketUtils::create_server_socket(int port, int backlog) {
     int server_socket = socket(AF_INET, SOCK_STREAM, 0);
     if (server_socket < 0) {
         throw_network_error("socket creation");
@@ -29,12 +120,12 @@ int SocketUtils::create_server_socket(int port) {
     }
     
     // Listen for connections
-    if (listen(server_socket, 1) < 0) {
+    if (listen(server_socket, backlog) < 0) {
         close(server_socket);
         throw_network_error("listen");
     }
     
-    LOG_INFO("Server socket created and listening on port " << port);
+    LOG_INFO("Server socket created and listening on port " << get_local_port(server_socket));
     return server_socket;
 }
 
@@ -85,28 +176,163 @@ int SocketUtils::connect_to_server(const std::string& hostname, int port) {
 }
 
 void SocketUtils::send_message(int socket, const Message& message) {
-    auto serialized = serialize_message(message);
-    send_data(socket, serialized);
+    send_message(socket, message.type, message.data.data(), message.data.size());
 }
 
-Message SocketUtils::receive_message(int socket) {
-    // First receive message header 
-    uint8_t header[5]; // 1 byte type + 4 bytes size
-    receive_all(socket, header, 5);
-    
-    MessageType type = static_cast<MessageType>(header[0]);
-    uint32_t size = (header[1] << 24) | (header[2] << 16) | (header[3] << 8) | header[4];
+void SocketUtils::send_message(int socket, MessageType type, const uint8_t* data, uint64_t size, bool zerocopy) {
+    // Headers and payload slices are gathered by the kernel, the payload is never copied here
+    std::vector<uint8_t> headers;
+    std::vector<struct iovec> iov;
+    frame_message(type, data, size, headers, iov);
+    send_gather(socket, iov.data(), iov.size(), zerocopy);
+}
+
+void SocketUtils::frame_message(MessageType type, const uint8_t* data, uint64_t size,
+                                std::vector<uint8_t>& headers, std::vector<struct iovec>& iov) {
+    if (size > MAX_MESSAGE_SIZE) {
+        throw NetworkException("Message size too large: " + std::to_string(size));
+    }
     
-    // Receive message data
-    std::vector<uint8_t> data;
-    if (size > 0) {
-        if (size > MAX_MESSAGE_SIZE) {
-            throw NetworkException("Message size too large: " + std::to_string(size));
+    size_t frames = frame_count(size);
+    size_t total_bytes = frames > 1 ? FRAME_TOTAL_SIZE : 0;
+    headers.assign(frames * FRAME_HEADER_SIZE + total_bytes, 0);
+    iov.reserve(iov.size() + 2 * frames);
+    uint64_t offset = 0;
+    for (size_t f = 0; f < frames; ++f) {
+        uint64_t chunk = std::min<uint64_t>(size - offset, MAX_FRAME_SIZE);
+        uint8_t flags = f + 1 < frames ? FRAME_CONTINUES : 0;
+        uint8_t* header = headers.data() + f * FRAME_HEADER_SIZE + (f > 0 ? total_bytes : 0);
+        size_t header_size = FRAME_HEADER_SIZE;
+        if (f == 0 && frames > 1) {
+            flags |= FRAME_TOTAL;
+            store_be64(header + FRAME_HEADER_SIZE, size);
+            header_size += FRAME_TOTAL_SIZE;
+        }
+        write_frame_header(header, type, flags, chunk);
+        iov.push_back({header, header_size});
+        if (chunk > 0) {
+            iov.push_back({const_cast<uint8_t*>(data + offset), static_cast<size_t>(chunk)});
         }
-        data = receive_data(socket, size);
+        offset += chunk;
+    }
+}
+
+size_t SocketUtils::frame_count(uint64_t size) {
+    return size == 0 ? 1 : static_cast<size_t>((size + MAX_FRAME_SIZE - 1) / MAX_FRAME_SIZE);
+}
+
+Message SocketUtils::receive_message(int socket) {
+    // Each frame's payload is received straight into its place, without
+    // zero-filling the buffer. The buffer grows by doubling up to the announced
+    // total, so a peer cannot make us allocate much more than it actually sends
+    Message message;
+    FrameHeader header = receive_frame_header(socket);
+    message.type = header.type;
+    uint64_t total = receive_message_total(socket, header);
+    uint64_t offset = 0;
+    for (;;) {
+        if (header.type != message.type) {
+            throw NetworkException("Message frames of different types");
+        }
+        if (header.size > total - offset) {
+            throw NetworkException("Message frames exceed the message length");
+        }
+        uint64_t needed = offset + header.size;
+        if (needed > message.data.capacity()) {
+            message.data.reserve(std::min<uint64_t>(total, std::max<uint64_t>(needed, 2 * message.data.capacity())));
+        }
+        message.data.resize(needed);
+        receive_all(socket, message.data.data() + offset, header.size);
+        offset += header.size;
+        if (!(header.flags & FRAME_CONTINUES)) {
+            break;
+        }
+        header = receive_frame_header(socket);
+        if (header.flags & FRAME_TOTAL) {
+            throw NetworkException("Message length in a continuation frame");
+        }
+    }
+    if (offset != total) {
+        throw NetworkException("Message frames fall short of the message length");
+    }
+    message.size = total;
+    return message;
+}
+
+uint64_t SocketUtils::receive_message_total(int socket, const FrameHeader& first) {
+    if (!(first.flags & FRAME_TOTAL)) {
+        return first.size;
+    }
+    uint8_t bytes[FRAME_TOTAL_SIZE];
+    receive_all(socket, bytes, FRAME_TOTAL_SIZE);
+    uint64_t total = load_be64(bytes);
+    if (total > MAX_MESSAGE_SIZE) {
+        throw NetworkException("Message size too large: " + std::to_string(total));
+    }
+    return total;
+}
+
+MessageType SocketUtils::receive_message_stream(int socket,
+                                                const std::function<void(const uint8_t*, size_t)>& consume) {
+    // Frames are handed on as they come, checked against the same length rules
+    // as receive_message
+    FrameHeader first = receive_frame_header(socket);
+    uint64_t total = receive_message_total(socket, first);
+    FrameHeader header = first;
+    std::vector<uint8_t> payload;
+    uint64_t offset = 0;
+    for (;;) {
+        if (header.type != first.type) {
+            throw NetworkException("Message frames of different types");
+        }
+        if (header.size > total - offset) {
+            throw NetworkException("Message frames exceed the message length");
+        }
+        payload.resize(header.size);
+        receive_all(socket, payload.data(), payload.size());
+        consume(payload.data(), payload.size());
+        offset += header.size;
+        if (!(header.flags & FRAME_CONTINUES)) {
+            break;
+        }
+        header = receive_frame_header(socket);
+        if (header.flags & FRAME_TOTAL) {
+            throw NetworkException("Message length in a continuation frame");
+        }
+    }
+    if (offset != total) {
+        throw NetworkException("Message frames fall short of the message length");
+    }
+    return first.type;
+}
+
+SocketUtils::FrameHeader SocketUtils::receive_frame_header(int socket) {
+    uint8_t bytes[FRAME_HEADER_SIZE];
+    receive_all(socket, bytes, FRAME_HEADER_SIZE);
+    FrameHeader header = parse_frame_header(bytes);
+    if (header.size > MAX_FRAME_SIZE) {
+        throw NetworkException("Frame size too large: " + std::to_string(header.size));
+    }
+    return header;
+}
+
+void SocketUtils::write_frame_header(uint8_t* out, MessageType type, uint8_t flags, uint64_t size) {
+    out[0] = static_cast<uint8_t>(type);
+    out[1] = flags;
+    for (int i = 0; i < 8; ++i) {
+        out[2 + i] = static_cast<uint8_t>(size >> (56 - 8 * i));
     }
-    
-    return Message(type, data);
+}
+
+SocketUtils::FrameHeader SocketUtils::parse_frame_header(const uint8_t* in) {
+    FrameHeader header;
+    header.type = static_cast<MessageType>(in[0]);
+    header.flags = in[1];
+    header.size = 0;
+    for (int i = 0; i < 8; ++i) {
+        header.size = (header.size << 8) | in[2 + i];
+    }
+    return header;
 }
 
 void SocketUtils::send_data(int socket, const std::vector<uint8_t>& data) {
@@ -119,6 +345,201 @@ std::vector<uint8_t> SocketUtils::receive_data(int socket, size_t size) {
     return data;
 }
 
+TransportBackend SocketUtils::transport() {
+    return active_transport();
+}
+
+void SocketUtils::set_transport(TransportBackend backend) {
+    if (!transport_supported(backend)) {
+        throw NetworkException(std::string("Transport not supported by this kernel: ") +
+                               transport_name(backend));
+    }
+    active_transport() = backend;
+}
+
+bool SocketUtils::transport_supported(TransportBackend backend) {
+    switch (backend) {
+        case TransportBackend::POSIX:
+            return true;
+        case TransportBackend::IO_URING:
+            return IoUring::supported();
+    }
+    return false;
+}
+
+const char* SocketUtils::transport_name(TransportBackend backend) {
+    switch (backend) {
+        case TransportBackend::POSIX: return "POSIX";
+        case TransportBackend::IO_URING: return "io_uring";
+    }
+    return "UNKNOWN";
+}
+
+void SocketUtils::send_bytes(int socket, const void* data, size_t size, bool zerocopy) {
+    if (!zerocopy) {
+        send_all(socket, data, size);
+        return;
+    }
+    struct iovec iov = {const_cast<void*>(data), size};
+    send_gather(socket, &iov, 1, true);
+}
+
+void SocketUtils::send_gather(int socket, const struct iovec* iov, size_t count, bool zerocopy) {
+    if (!zerocopy && transport() == TransportBackend::IO_URING) {
+        IoUring::thread_ring().send_gather(socket, iov, count);
+        return;
+    }
+    
+    // Partial sends advance a private copy of the list
+    std::vector<struct iovec> pending(iov, iov + count);
+    size_t remaining = 0;
+    for (const auto& piece : pending) {
+        remaining += piece.iov_len;
+    }
+    
+    size_t first = 0;
+    uint32_t zerocopy_sends = 0;
+    while (remaining > 0) {
+        while (pending[first].iov_len == 0) {
+            ++first;
+        }
+        
+        struct msghdr msg = {};
+        msg.msg_iov = pending.data() + first;
+        msg.msg_iovlen = std::min<size_t>(pending.size() - first, IOV_MAX);
+        bool use_zerocopy = zerocopy && remaining >= ZEROCOPY_MIN_BYTES;
+        int flags = MSG_NOSIGNAL;
+#ifdef __linux__
+        if (use_zerocopy) {
+            flags |= MSG_ZEROCOPY;
+        }
+#endif
+        
+        ssize_t sent = sendmsg(socket, &msg, flags);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                wait_ready(socket, POLLOUT);
+                continue;
+            }
+            if (use_zerocopy && errno == ENOBUFS) {
+                // Out of pinnable memory: copy the rest
+                zerocopy = false;
+                continue;
+            }
+            throw_network_error("sendmsg");
+        }
+        if (use_zerocopy) {
+            zerocopy_sends++;
+        }
+        
+        remaining -= sent;
+        size_t advance = static_cast<size_t>(sent);
+        while (advance > 0) {
+            struct iovec& piece = pending[first];
+            size_t step = std::min(advance, piece.iov_len);
+            piece.iov_base = static_cast<uint8_t*>(piece.iov_base) + step;
+            piece.iov_len -= step;
+            advance -= step;
+            if (piece.iov_len == 0) {
+                ++first;
+            }
+        }
+    }
+    
+    if (zerocopy_sends > 0) {
+        wait_zerocopy(socket, zerocopy_sends);
+    }
+}
+
+bool SocketUtils::enable_zerocopy(int socket) {
+#ifdef __linux__
+    int one = 1;
+    return setsockopt(socket, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+#else
+    (void)socket;
+    return false;
+#endif
+}
+
+void SocketUtils::wait_zerocopy(int socket, uint32_t sends) {
+#ifdef __linux__
+    // Each MSG_ZEROCOPY send is numbered; completions arrive on the socket's error
+    // queue as ranges of those numbers
+    uint32_t completed = 0;
+    while (completed < sends) {
+        alignas(struct cmsghdr) char control[128];
+        struct msghdr msg = {};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(socket, &msg, MSG_ERRQUEUE) < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                throw_network_error("recvmsg(MSG_ERRQUEUE)");
+            }
+            // Nothing queued yet; a pending error queue shows up as POLLERR
+            struct pollfd pfd = {socket, 0, 0};
+            int ready = poll(&pfd, 1, SOCKET_TIMEOUT * 1000);
+            if (ready < 0 && errno != EINTR) {
+                throw_network_error("poll");
+            }
+            if (ready == 0) {
+                throw NetworkException("Timed out waiting for zero-copy send completion");
+            }
+            continue;
+        }
+        
+        for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+            bool recverr = (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                           (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR);
+            if (!recverr) {
+                continue;
+            }
+            const auto* err = reinterpret_cast<const struct sock_extended_err*>(CMSG_DATA(cm));
+            if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            if (err->ee_errno != 0) {
+                errno = static_cast<int>(err->ee_errno);
+                throw_network_error("zero-copy send");
+            }
+            completed += err->ee_data - err->ee_info + 1;
+        }
+    }
+#else
+    (void)socket;
+    (void)sends;
+#endif
+}
+
+void SocketUtils::receive_bytes(int socket, void* data, size_t size) {
+    receive_all(socket, data, size);
+}
+
+void SocketUtils::receive_bytes_within(int socket, void* data, size_t size, int timeout_ms) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    uint8_t* bytes = static_cast<uint8_t*>(data);
+    size_t total_received = 0;
+    while (total_received < size) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0 || !socket_ready_for_read(socket, static_cast<int>(left))) {
+            throw NetworkException("Timed out waiting for the peer");
+        }
+        ssize_t received = recv(socket, bytes + total_received, size - total_received, MSG_DONTWAIT);
+        if (received < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                continue;
+            }
+            throw_network_error("recv");
+        } else if (received == 0) {
+            throw NetworkException("Connection closed by peer");
+        }
+        total_received += received;
+    }
+}
+
 void SocketUtils::send_wire_label(int socket, const WireLabel& label) {
     send_all(socket, label.data(), WIRE_LABEL_SIZE);
 }
@@ -199,50 +620,112 @@ std::string SocketUtils::get_local_ip() {
     return "127.0.0.1";
 }
 
+int SocketUtils::get_local_port(int socket) {
+    struct sockaddr_in address;
+    socklen_t length = sizeof(address);
+    if (getsockname(socket, reinterpret_cast<struct sockaddr*>(&address), &length) < 0) {
+        throw_network_error("getsockname");
+    }
+    return ntohs(address.sin_port);
+}
+
+void SocketUtils::get_peer_address(int socket, std::string& ip, int& port) {
+    struct sockaddr_in address;
+    socklen_t length = sizeof(address);
+    if (getpeername(socket, reinterpret_cast<struct sockaddr*>(&address), &length) < 0) {
+        throw_network_error("getpeername");
+    }
+    char buffer[INET_ADDRSTRLEN];
+    if (inet_ntop(AF_INET, &address.sin_addr, buffer, sizeof(buffer)) == nullptr) {
+        throw_network_error("inet_ntop");
+    }
+    ip = buffer;
+    port = ntohs(address.sin_port);
+}
+
 std::vector<uint8_t> SocketUtils::serialize_message(const Message& message) {
     std::vector<uint8_t> serialized;
-    
-    // Add message type
-    serialized.push_back(static_cast<uint8_t>(message.type));
-    
-    // Add message size 
-    uint32_t size = message.size;
-    serialized.push_back((size >> 24) & 0xFF);
-    serialized.push_back((size >> 16) & 0xFF);
-    serialized.push_back((size >> 8) & 0xFF);
-    serialized.push_back(size & 0xFF);
-    
-    // Add message data
-    serialized.insert(serialized.end(), message.data.begin(), message.data.end());
-    
+    uint64_t size = message.data.size();
+    uint64_t offset = 0;
+    do {
+        uint64_t chunk = std::min<uint64_t>(size - offset, MAX_FRAME_SIZE);
+        uint8_t flags = offset + chunk < size ? FRAME_CONTINUES : 0;
+        bool first_of_several = offset == 0 && chunk < size;
+        if (first_of_several) {
+            flags |= FRAME_TOTAL;
+        }
+        size_t header_at = serialized.size();
+        serialized.resize(header_at + FRAME_HEADER_SIZE + (first_of_several ? FRAME_TOTAL_SIZE : 0));
+        write_frame_header(serialized.data() + header_at, message.type, flags, chunk);
+        if (first_of_several) {
+            store_be64(serialized.data() + header_at + FRAME_HEADER_SIZE, size);
+        }
+        serialized.insert(serialized.end(), message.data.begin() + offset, message.data.begin() + offset + chunk);
+        offset += chunk;
+    } while (offset < size);
     return serialized;
 }
 
 Message SocketUtils::deserialize_message(const std::vector<uint8_t>& data) {
-    if (data.size() < 5) {
-        throw NetworkException("Invalid message data: too small");
+    Message message;
+    size_t pos = 0;
+    for (;;) {
+        if (data.size() - pos < FRAME_HEADER_SIZE) {
+            throw NetworkException("Invalid message data: too small");
+        }
+        FrameHeader header = parse_frame_header(data.data() + pos);
+        bool first = pos == 0;
+        pos += FRAME_HEADER_SIZE;
+        if (first) {
+            message.type = header.type;
+        } else if (header.type != message.type) {
+            throw NetworkException("Invalid message data: frames of different types");
+        }
+        if (header.flags & FRAME_TOTAL) {
+            if (!first || data.size() - pos < FRAME_TOTAL_SIZE) {
+                throw NetworkException("Invalid message data: misplaced message length");
+            }
+            uint64_t total = load_be64(data.data() + pos);
+            if (total > data.size()) {
+                throw NetworkException("Invalid message data: size mismatch");
+            }
+            message.data.reserve(total);
+            pos += FRAME_TOTAL_SIZE;
+        }
+        if (header.size > MAX_FRAME_SIZE || header.size > data.size() - pos) {
+            throw NetworkException("Invalid message data: size mismatch");
+        }
+        message.data.insert(message.data.end(), data.begin() + pos, data.begin() + pos + header.size);
+        pos += header.size;
+        if (!(header.flags & FRAME_CONTINUES)) {
+            break;
+        }
     }
-    
-    MessageType type = static_cast<MessageType>(data[0]);
-    uint32_t size = (data[1] << 24) | (data[2] << 16) | (data[3] << 8) | data[4];
-    
-    if (data.size() != 5 + size) {
+    if (pos != data.size()) {
         throw NetworkException("Invalid message data: size mismatch");
     }
-    
-    std::vector<uint8_t> msg_data(data.begin() + 5, data.end());
-    return Message(type, msg_data);
+    message.size = message.data.size();
+    return message;
 }
 
 void SocketUtils::send_all(int socket, const void* data, size_t size) {
+    if (transport() == TransportBackend::IO_URING) {
+        IoUring::thread_ring().send_all(socket, data, size);
+        return;
+    }
+    
     const uint8_t* bytes = static_cast<const uint8_t*>(data);
     size_t total_sent = 0;
     
     while (total_sent < size) {
         ssize_t sent = send(socket, bytes + total_sent, size - total_sent, MSG_NOSIGNAL);
         if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                continue; 
+                wait_ready(socket, POLLOUT);
+                continue;
             }
             throw_network_error("send");
         }
@@ -251,14 +734,23 @@ void SocketUtils::send_all(int socket, const void* data, size_t size) {
 }
 
 void SocketUtils::receive_all(int socket, void* data, size_t size) {
+    if (transport() == TransportBackend::IO_URING) {
+        IoUring::thread_ring().receive_all(socket, data, size);
+        return;
+    }
+    
     uint8_t* bytes = static_cast<uint8_t*>(data);
     size_t total_received = 0;
     
     while (total_received < size) {
         ssize_t received = recv(socket, bytes + total_received, size - total_received, 0);
         if (received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                continue; 
+                wait_ready(socket, POLLIN);
+                continue;
             }
             throw_network_error("recv");
         } else if (received == 0) {
@@ -268,6 +760,20 @@ void SocketUtils::receive_all(int socket, void* data, size_t size) {
     }
 }
 
+void SocketUtils::wait_ready(int socket, short events) {
+    struct pollfd pfd = {socket, events, 0};
+    int ready;
+    do {
+        ready = poll(&pfd, 1, SOCKET_TIMEOUT * 1000);
+    } while (ready < 0 && errno == EINTR);
+    if (ready < 0) {
+        throw_network_error("poll");
+    }
+    if (ready == 0) {
+        throw NetworkException("Timed out waiting for the socket");
+    }
+}
+
 void SocketUtils::throw_network_error(const std::string& operation) {
     std::stringstream ss;
     ss << operation << " failed: " << std::strerror(errno) << " (errno=" << errno << ")";
@@ -275,9 +781,9 @@ void SocketUtils::throw_network_error(const std::string& operation) {
 }
 
 // SocketConnection implementation
-SocketConnection::SocketConnection(int port) 
+SocketConnection::SocketConnection(int port, int backlog)
     : server_socket(-1), comm_socket(-1), is_server(true) {
-    server_socket = SocketUtils::create_server_socket(port);
+    server_socket = SocketUtils::create_server_socket(port, backlog);
 }
 
 SocketConnection::SocketConnection(const std::string& hostname, int port)
@@ -319,6 +825,30 @@ void SocketConnection::wait_for_client() {
     comm_socket = SocketUtils::accept_client(server_socket);
 }
 
+std::unique_ptr<SocketConnection> SocketConnection::accept_connection() {
+    if (!is_server || server_socket < 0) {
+        throw NetworkException("Not a server connection");
+    }
+    
+    std::unique_ptr<SocketConnection> session(new SocketConnection());
+    session->comm_socket = SocketUtils::accept_client(server_socket);
+    return session;
+}
+
+bool SocketConnection::wait_for_connection(int timeout_ms) {
+    if (!is_server || server_socket < 0) {
+        throw NetworkException("Not a server connection");
+    }
+    return SocketUtils::socket_ready_for_read(server_socket, timeout_ms);
+}
+
+int SocketConnection::local_port() const {
+    if (!is_server || server_socket < 0) {
+        throw NetworkException("Not a server connection");
+    }
+    return SocketUtils::get_local_port(server_socket);
+}
+
 void SocketConnection::close() {
     cleanup();
 }
@@ -356,21 +886,74 @@ std::string ProtocolManager::receive_hello() {
 }
 
 void ProtocolManager::send_circuit(const GarbledCircuit& garbled_circuit) {
+    auto serialized = describe_circuit(garbled_circuit);
+    
+    if (!stripes_.empty()) {
+        SocketUtils::send_message(connection->get_socket(), MessageType::CIRCUIT,
+                                  serialized.data(), serialized.size(), zerocopy_);
+        send_striped(garbled_circuit.tables.data(), garbled_circuit.table_bytes());
+        std::cout << "[PROTOCOL] Circuit transmission completed over " << stripes_.size()
+                  << " data connections" << std::endl;
+        return;
+    }
+    
+    // Description frames, then the table arena as is (its size follows from the
+    // description), gathered into one send without joining the buffers
+    std::vector<uint8_t> headers;
+    std::vector<struct iovec> iov;
+    SocketUtils::frame_message(MessageType::CIRCUIT, serialized.data(), serialized.size(), headers, iov);
+    if (garbled_circuit.table_bytes() > 0) {
+        iov.push_back({const_cast<uint8_t*>(garbled_circuit.tables.data()), garbled_circuit.table_bytes()});
+    }
+    SocketUtils::send_gather(connection->get_socket(), iov.data(), iov.size(), zerocopy_);
+    std::cout << "[PROTOCOL] Circuit transmission completed" << std::endl;
+}
+
+void ProtocolManager::send_circuit_description(const GarbledCircuit& garbled_circuit) {
+    auto serialized = describe_circuit(garbled_circuit);
+    SocketUtils::send_message(connection->get_socket(), MessageType::CIRCUIT,
+                              serialized.data(), serialized.size(), zerocopy_);
+}
+
+std::vector<uint8_t> ProtocolManager::describe_circuit(const GarbledCircuit& garbled_circuit) {
     std::cout << "[PROTOCOL] Sending garbled circuit to evaluator" << std::endl;
     std::cout << "           Circuit: " << garbled_circuit.circuit.gates.size() << " gates, " 
               << garbled_circuit.circuit.num_inputs << " inputs, " 
               << garbled_circuit.circuit.num_outputs << " outputs" << std::endl;
     
     auto serialized = serialize_garbled_circuit(garbled_circuit);
-    std::cout << "           Serialized size: " << serialized.size() << " bytes" << std::endl;
-    Message msg(MessageType::CIRCUIT, serialized);
-    SocketUtils::send_message(connection->get_socket(), msg);
-    std::cout << "[PROTOCOL] Circuit transmission completed" << std::endl;
+    std::cout << "           Serialized size: " << serialized.size() << " bytes + "
+              << garbled_circuit.table_bytes() << " bytes of garbled tables" << std::endl;
+    return serialized;
+}
+
+void ProtocolManager::send_table_chunk(const uint8_t* data, size_t size) {
+    if (stripes_.empty()) {
+        SocketUtils::send_bytes(connection->get_socket(), data, size, zerocopy_);
+        return;
+    }
+    for (size_t offset = 0; offset < size; offset += STRIPE_CHUNK_BYTES) {
+        send_stripe_chunk(stripe_seq_++, data + offset, std::min(STRIPE_CHUNK_BYTES, size - offset));
+    }
 }
 
 GarbledCircuit ProtocolManager::receive_circuit() {
+    auto gc = receive_circuit_description();
+    if (gc.streamed) {
+        throw NetworkException("Streamed circuit: tables follow the input labels");
+    }
+    receive_tables(gc);
+    return gc;
+}
+
+GarbledCircuit ProtocolManager::receive_circuit_description() {
     std::cout << "[PROTOCOL] Waiting to receive garbled circuit..." << std::endl;
     Message msg = SocketUtils::receive_message(connection->get_socket());
+    if (msg.type == MessageType::STRIPES) {
+        // The tables will come over parallel data connections
+        join_stripes(msg);
+        msg = SocketUtils::receive_message(connection->get_socket());
+    }
     std::cout << "[PROTOCOL] Received circuit data (" << msg.data.size() << " bytes)" << std::endl;
     if (msg.type != MessageType::CIRCUIT) {
         throw NetworkException("Expected CIRCUIT message");
@@ -383,6 +966,171 @@ GarbledCircuit ProtocolManager::receive_circuit() {
     return gc;
 }
 
+void ProtocolManager::receive_tables(GarbledCircuit& gc) {
+    // Received in place into the aligned arena, without zero-filling it first
+    gc.tables.clear();
+    gc.tables.resize(gc.table_bytes());
+    if (!stripes_.empty()) {
+        receive_striped(gc.tables.data(), gc.table_bytes());
+    } else if (SocketUtils::transport() == TransportBackend::IO_URING) {
+        // Pinned once for the whole arena instead of per read
+        IoUring::BufferRegistration registration(IoUring::thread_ring(), gc.tables.data(), gc.table_bytes());
+        receive_table_chunk(gc.tables.data(), gc.table_bytes());
+    } else {
+        receive_table_chunk(gc.tables.data(), gc.table_bytes());
+    }
+    std::cout << "[PROTOCOL] Received garbled tables (" << gc.table_bytes() << " bytes)" << std::endl;
+}
+
+void ProtocolManager::receive_table_chunk(uint8_t* data, size_t size) {
+    if (stripes_.empty()) {
+        SocketUtils::receive_bytes(connection->get_socket(), data, size);
+        return;
+    }
+    for (size_t offset = 0; offset < size; offset += STRIPE_CHUNK_BYTES) {
+        receive_stripe_chunk(stripe_seq_++, data + offset, std::min(STRIPE_CHUNK_BYTES, size - offset));
+    }
+}
+
+void ProtocolManager::open_stripes(size_t count) {
+    if (count == 0 || count > MAX_STRIPES) {
+        throw NetworkException("Data connection count must be between 1 and " + std::to_string(MAX_STRIPES));
+    }
+    
+    // The data connections get a listener of their own on an ephemeral port, so
+    // they never compete with the next session's control connection. A random
+    // token ties them to this session
+    SocketConnection listener(0, static_cast<int>(count));
+    WireLabel token = CryptoUtils::generate_random_label();
+    std::vector<uint8_t> announce(8 + WIRE_LABEL_SIZE);
+    store_be32(announce.data(), static_cast<uint32_t>(count));
+    store_be32(announce.data() + 4, static_cast<uint32_t>(listener.local_port()));
+    std::copy(token.begin(), token.end(), announce.begin() + 8);
+    SocketUtils::send_message(connection->get_socket(), Message(MessageType::STRIPES, announce));
+    
+    // All of them must join within SOCKET_TIMEOUT; a connection that sends
+    // anything else, or nothing within STRIPE_JOIN_TIMEOUT_MS, is dropped and the
+    // next one accepted
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(SOCKET_TIMEOUT);
+    std::vector<std::unique_ptr<SocketConnection>> stripes(count);
+    size_t joined = 0;
+    while (joined < count) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0 || !listener.wait_for_connection(static_cast<int>(left))) {
+            throw NetworkException("Timed out waiting for data connections (" + std::to_string(joined) +
+                                   " of " + std::to_string(count) + " joined)");
+        }
+        auto stripe = listener.accept_connection();
+        uint8_t join[STRIPE_JOIN_SIZE];
+        try {
+            int join_timeout = static_cast<int>(std::min<long long>(left, STRIPE_JOIN_TIMEOUT_MS));
+            SocketUtils::receive_bytes_within(stripe->get_socket(), join, STRIPE_JOIN_SIZE, join_timeout);
+        } catch (const NetworkException& e) {
+            LOG_WARNING("Dropped a data connection: " << e.what());
+            continue;
+        }
+        uint32_t index = load_be32(join);
+        if (!std::equal(token.begin(), token.end(), join + 4) || index >= count || stripes[index]) {
+            LOG_WARNING("Dropped a data connection without a valid join");
+            continue;
+        }
+        if (zerocopy_ && !SocketUtils::enable_zerocopy(stripe->get_socket())) {
+            LOG_WARNING("MSG_ZEROCOPY is not supported on a data connection; sending with copies");
+            zerocopy_ = false;
+        }
+        stripes[index] = std::move(stripe);
+        joined++;
+    }
+    stripes_ = std::move(stripes);
+    stripe_seq_ = 0;
+    std::cout << "[PROTOCOL] Opened " << count << " data connections for the garbled tables" << std::endl;
+}
+
+void ProtocolManager::join_stripes(const Message& msg) {
+    if (msg.data.size() != 8 + WIRE_LABEL_SIZE) {
+        throw NetworkException("Invalid STRIPES message");
+    }
+    uint32_t count = load_be32(msg.data.data());
+    uint32_t port = load_be32(msg.data.data() + 4);
+    if (count == 0 || count > MAX_STRIPES) {
+        throw NetworkException("Invalid data connection count: " + std::to_string(count));
+    }
+    if (port == 0 || port > 65535) {
+        throw NetworkException("Invalid data connection port: " + std::to_string(port));
+    }
+    
+    // The garbler's address, at the port it announced for this session
+    std::string ip;
+    int control_port;
+    SocketUtils::get_peer_address(connection->get_socket(), ip, control_port);
+    std::vector<std::unique_ptr<SocketConnection>> stripes;
+    for (uint32_t i = 0; i < count; ++i) {
+        auto stripe = std::make_unique<SocketConnection>(ip, static_cast<int>(port));
+        uint8_t join[STRIPE_JOIN_SIZE];
+        store_be32(join, i);
+        std::copy(msg.data.begin() + 8, msg.data.end(), join + 4);
+        SocketUtils::send_bytes(stripe->get_socket(), join, STRIPE_JOIN_SIZE);
+        stripes.push_back(std::move(stripe));
+    }
+    stripes_ = std::move(stripes);
+    stripe_seq_ = 0;
+    std::cout << "[PROTOCOL] Joined " << count << " data connections for the garbled tables" << std::endl;
+}
+
+void ProtocolManager::send_striped(const uint8_t* data, size_t size) {
+    // Chunk k goes over connection k mod n; every connection sends its own
+    // chunks in order, all connections at once
+    uint64_t first = stripe_seq_;
+    uint64_t chunks = (size + STRIPE_CHUNK_BYTES - 1) / STRIPE_CHUNK_BYTES;
+    stripe_seq_ += chunks;
+    run_per_stripe(stripes_.size(), [&](size_t stripe) {
+        for (uint64_t k = (stripes_.size() - first % stripes_.size() + stripe) % stripes_.size();
+             k < chunks; k += stripes_.size()) {
+            size_t offset = static_cast<size_t>(k) * STRIPE_CHUNK_BYTES;
+            send_stripe_chunk(first + k, data + offset, std::min(STRIPE_CHUNK_BYTES, size - offset));
+        }
+    });
+}
+
+void ProtocolManager::receive_striped(uint8_t* data, size_t size) {
+    // Each chunk lands at its own offset in the arena, whichever connection
+    // delivers first
+    uint64_t first = stripe_seq_;
+    uint64_t chunks = (size + STRIPE_CHUNK_BYTES - 1) / STRIPE_CHUNK_BYTES;
+    stripe_seq_ += chunks;
+    run_per_stripe(stripes_.size(), [&](size_t stripe) {
+        for (uint64_t k = (stripes_.size() - first % stripes_.size() + stripe) % stripes_.size();
+             k < chunks; k += stripes_.size()) {
+            size_t offset = static_cast<size_t>(k) * STRIPE_CHUNK_BYTES;
+            receive_stripe_chunk(first + k, data + offset, std::min(STRIPE_CHUNK_BYTES, size - offset));
+        }
+    });
+}
+
+void ProtocolManager::send_stripe_chunk(uint64_t seq, const uint8_t* data, size_t size) {
+    uint8_t header[STRIPE_HEADER_SIZE];
+    store_be64(header, seq);
+    store_be32(header + 8, static_cast<uint32_t>(size));
+    struct iovec iov[2] = {{header, STRIPE_HEADER_SIZE}, {const_cast<uint8_t*>(data), size}};
+    const auto& stripe = stripes_[seq % stripes_.size()];
+    SocketUtils::send_gather(stripe->get_socket(), iov, 2, zerocopy_);
+}
+
+void ProtocolManager::receive_stripe_chunk(uint64_t seq, uint8_t* data, size_t size) {
+    const auto& stripe = stripes_[seq % stripes_.size()];
+    uint8_t header[STRIPE_HEADER_SIZE];
+    SocketUtils::receive_bytes(stripe->get_socket(), header, STRIPE_HEADER_SIZE);
+    uint64_t got_seq = load_be64(header);
+    uint32_t got_size = load_be32(header + 8);
+    if (got_seq != seq || got_size != size) {
+        throw NetworkException("Out of order table chunk: expected #" + std::to_string(seq) + " (" +
+                               std::to_string(size) + " bytes), got #" + std::to_string(got_seq) +
+                               " (" + std::to_string(got_size) + " bytes)");
+    }
+    SocketUtils::receive_bytes(stripe->get_socket(), data, size);
+}
+
 void ProtocolManager::send_input_labels(const std::vector<WireLabel>& labels) {
     std::vector<uint8_t> data;
     
@@ -444,7 +1192,7 @@ std::vector<uint8_t> ProtocolManager::receive_result() {
     if (msg.type != MessageType::RESULT) {
         throw NetworkException("Expected RESULT message");
     }
-    return msg.data;
+    return std::vector<uint8_t>(msg.data.begin(), msg.data.end());
 }
 
 void ProtocolManager::send_error(const std::string& error_message) {
@@ -466,8 +1214,15 @@ bool ProtocolManager::is_connected() const {
     return connection && connection->is_connected();
 }
 
+bool ProtocolManager::enable_zerocopy() {
+    zerocopy_ = SocketUtils::enable_zerocopy(connection->get_socket());
+    return zerocopy_;
+}
+
 std::vector<uint8_t> ProtocolManager::serialize_garbled_circuit(const GarbledCircuit& gc) {
     std::vector<uint8_t> data;
+    data.reserve(13 + 4 * (gc.circuit.input_wires.size() + gc.circuit.output_wires.size()) +
+                 13 * gc.circuit.gates.size());
     
     // Add circuit basic info
     uint32_t num_gates = gc.circuit.num_gates;
@@ -489,6 +1244,9 @@ std::vector<uint8_t> ProtocolManager::serialize_garbled_circuit(const GarbledCir
     data.push_back((num_outputs >> 8) & 0xFF);
     data.push_back(num_outputs & 0xFF);
     
+    // Garbling mode, decides which gates carry a table
+    data.push_back(gc.mode_flags());
+    
     // Add input wires
     for (int wire : gc.circuit.input_wires) {
         data.push_back((wire >> 24) & 0xFF);
@@ -525,86 +1283,65 @@ std::vector<uint8_t> ProtocolManager::serialize_garbled_circuit(const GarbledCir
         data.push_back(static_cast<uint8_t>(gate.type));
     }
     
-    // Add garbled gates 
-    for (size_t i = 0; i < gc.garbled_gates.size(); ++i) {
-        const auto& garbled_gate = gc.garbled_gates[i];
-        for (size_t j = 0; j < garbled_gate.ciphertexts.size(); ++j) {
-            const auto& ciphertext = garbled_gate.ciphertexts[j];
-            data.insert(data.end(), ciphertext.begin(), ciphertext.end());
-        }
-    }
-    
     return data;
 }
 
-GarbledCircuit ProtocolManager::deserialize_garbled_circuit(const std::vector<uint8_t>& data) {
-    if (data.size() < 12) {
+GarbledCircuit ProtocolManager::deserialize_garbled_circuit(const MessageBuffer& data) {
+    if (data.size() < 13) {
         throw NetworkException("Invalid garbled circuit data");
     }
     
-    GarbledCircuit gc;
-    size_t offset = 0;
-    
     // Deserialize basic info
-    uint32_t num_gates = (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
-    uint32_t num_inputs = (data[4] << 24) | (data[5] << 16) | (data[6] << 8) | data[7];
-    uint32_t num_outputs = (data[8] << 24) | (data[9] << 16) | (data[10] << 8) | data[11];
+    const uint8_t* bytes = data.data();
+    uint32_t num_gates = load_be32(bytes);
+    uint32_t num_inputs = load_be32(bytes + 4);
+    uint32_t num_outputs = load_be32(bytes + 8);
     
+    // The counts fix the layout: header, input wires, output wires, 13-byte gates.
+    // With the size checked once, the fields below are read at known offsets
+    uint64_t expected = 13 + 4 * (static_cast<uint64_t>(num_inputs) + num_outputs) + 13 * static_cast<uint64_t>(num_gates);
+    if (data.size() != expected) {
+        throw NetworkException("Invalid circuit data: " + std::to_string(data.size()) + " bytes, expected " +
+                               std::to_string(expected));
+    }
+    
+    GarbledCircuit gc;
     gc.circuit.num_gates = num_gates;
     gc.circuit.num_inputs = num_inputs;
     gc.circuit.num_outputs = num_outputs;
-    offset = 12;
+    // Wires are numbered densely, inputs first, then one per gate output
+    gc.circuit.num_wires = static_cast<int>(num_inputs + num_gates);
     
-    // Deserialize input wires
-    for (uint32_t i = 0; i < num_inputs; ++i) {
-        if (offset + 4 > data.size()) throw NetworkException("Invalid circuit data: input wires");
-        int wire = (data[offset] << 24) | (data[offset+1] << 16) | (data[offset+2] << 8) | data[offset+3];
-        gc.circuit.input_wires.push_back(wire);
-        offset += 4;
-    }
+    uint8_t flags = bytes[12];
+    gc.point_and_permute = (flags & GC_FLAG_POINT_AND_PERMUTE) != 0;
+    gc.free_xor = (flags & GC_FLAG_FREE_XOR) != 0;
+    gc.streamed = (flags & GC_FLAG_STREAMED) != 0;
+    gc.scheme = static_cast<GarblingScheme>(flags >> 4);
     
-    // Deserialize output wires
-    for (uint32_t i = 0; i < num_outputs; ++i) {
-        if (offset + 4 > data.size()) throw NetworkException("Invalid circuit data: output wires");
-        int wire = (data[offset] << 24) | (data[offset+1] << 16) | (data[offset+2] << 8) | data[offset+3];
-        gc.circuit.output_wires.push_back(wire);
-        offset += 4;
+    const uint8_t* in = bytes + 13;
+    gc.circuit.input_wires.resize(num_inputs);
+    for (uint32_t i = 0; i < num_inputs; ++i, in += 4) {
+        gc.circuit.input_wires[i] = static_cast<int>(load_be32(in));
     }
-    
-    // Deserialize gates
-    for (uint32_t i = 0; i < num_gates; ++i) {
-        if (offset + 13 > data.size()) throw NetworkException("Invalid circuit data: gates");
-        
-        int input1 = (data[offset] << 24) | (data[offset+1] << 16) | (data[offset+2] << 8) | data[offset+3];
-        offset += 4;
-        
-        int input2 = (data[offset] << 24) | (data[offset+1] << 16) | (data[offset+2] << 8) | data[offset+3];
-        offset += 4;
-        
-        int output = (data[offset] << 24) | (data[offset+1] << 16) | (data[offset+2] << 8) | data[offset+3];
-        offset += 4;
-        
-        GateType gate_type = static_cast<GateType>(data[offset]);
-        offset += 1;
-        
-        Gate gate(output, input1, input2, gate_type);
-        gc.circuit.gates.push_back(gate);
+    gc.circuit.output_wires.resize(num_outputs);
+    for (uint32_t i = 0; i < num_outputs; ++i, in += 4) {
+        gc.circuit.output_wires[i] = static_cast<int>(load_be32(in));
     }
     
-    // Deserialize garbled gates (ciphertexts)
-    gc.garbled_gates.resize(num_gates);
-    for (uint32_t i = 0; i < num_gates; ++i) {
-        for (int j = 0; j < 4; ++j) { // 4 ciphertexts per truth table
-            size_t ciphertext_size = WIRE_LABEL_SIZE + 16; // Size as defined in GarbledGate
-            if (offset + ciphertext_size > data.size()) {
-                throw NetworkException("Invalid circuit data: garbled gates");
-            }
-            
-            std::vector<uint8_t> ciphertext(data.begin() + offset, data.begin() + offset + ciphertext_size);
-            gc.garbled_gates[i].ciphertexts[j] = ciphertext;
-            offset += ciphertext_size;
+    gc.circuit.gates.reserve(num_gates);
+    for (uint32_t i = 0; i < num_gates; ++i, in += 13) {
+        // Only logic gates; the wiring is checked before evaluation
+        if (in[12] > static_cast<uint8_t>(GateType::NOT)) {
+            throw NetworkException("Invalid gate type " + std::to_string(in[12]) + " in circuit data");
         }
+        gc.circuit.gates.emplace_back(static_cast<int>(load_be32(in + 8)),  // output
+                                      static_cast<int>(load_be32(in)),      // input 1
+                                      static_cast<int>(load_be32(in + 4)),  // input 2
+                                      static_cast<GateType>(in[12]));
     }
     
+    // Table sizes follow from the gate types and the mode flags
+    gc.compute_table_offsets();
+    
     return gc;
 }
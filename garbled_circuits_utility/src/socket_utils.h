@@ -8,6 +8,15 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <sys/uio.h>
+#include <functional>
+
+// Byte transport behind send/receive, chosen once at startup (GC_TRANSPORT
+// or set_transport())
+enum class TransportBackend {
+    POSIX,    // send/recv/sendmsg, waiting in poll() when the socket is not ready
+    IO_URING  // Batched, completion-driven io_uring submissions (Linux)
+};
 
 /**
  * Socket utilities for network communication between garbler and evaluator
@@ -18,8 +27,8 @@ public:
      * Server-side functions (for garbler)
      */
     
-    // Create and bind server socket
-    static int create_server_socket(int port);
+    // Create and bind server socket; port 0 picks a free ephemeral port
+    static int create_server_socket(int port, int backlog = 1);
     
     // Wait for client connection
     static int accept_client(int server_socket);
@@ -35,18 +44,50 @@ public:
      * Communication functions (for both sides)
      */
     
-    // Send message over socket
+    // Send message over socket, split into frames of at most MAX_FRAME_SIZE bytes
     static void send_message(int socket, const Message& message);
+    static void send_message(int socket, MessageType type, const uint8_t* data, uint64_t size,
+                             bool zerocopy = false);
     
-    // Receive message from socket
+    // Receive message from socket, reassembling its frames (up to MAX_MESSAGE_SIZE bytes)
     static Message receive_message(int socket);
     
+    // Receive a message frame by frame without reassembling it: consume(data, size)
+    // sees each frame's payload in order, and no more than MAX_FRAME_SIZE bytes
+    // are held at a time. Returns the message type
+    static MessageType receive_message_stream(int socket,
+                                              const std::function<void(const uint8_t*, size_t)>& consume);
+    
     // Send raw data
     static void send_data(int socket, const std::vector<uint8_t>& data);
     
     // Receive raw data of specified size
     static std::vector<uint8_t> receive_data(int socket, size_t size);
     
+    // Send/receive a caller-owned buffer as is: no framing, no copy
+    static void send_bytes(int socket, const void* data, size_t size, bool zerocopy = false);
+    static void receive_bytes(int socket, void* data, size_t size);
+    
+    // Receive exactly size bytes within timeout_ms, with plain recv whatever the
+    // transport, for handshakes from peers that may never send them. Throws
+    // NetworkException on timeout
+    static void receive_bytes_within(int socket, void* data, size_t size, int timeout_ms);
+    
+    // Send count buffers back to back with sendmsg, without joining them first
+    // (handles partial sends). With zerocopy (after enable_zerocopy) sends of at
+    // least ZEROCOPY_MIN_BYTES use MSG_ZEROCOPY, and the call returns only once
+    // the kernel no longer reads the buffers
+    static void send_gather(int socket, const struct iovec* iov, size_t count, bool zerocopy = false);
+    
+    // Frame a message for send_gather: fills headers with its frame headers and
+    // appends the header and payload pieces to iov, which point into headers and
+    // data; both must outlive the send
+    static void frame_message(MessageType type, const uint8_t* data, uint64_t size,
+                              std::vector<uint8_t>& headers, std::vector<struct iovec>& iov);
+    
+    // Opt the socket into MSG_ZEROCOPY sends; false where the kernel lacks it
+    static bool enable_zerocopy(int socket);
+    
     // Send wire label
     static void send_wire_label(int socket, const WireLabel& label);
     
@@ -75,16 +116,66 @@ public:
     // Check if socket is ready for writing
     static bool socket_ready_for_write(int socket, int timeout_ms);
     
+    // Active transport; set_transport() throws NetworkException if the kernel
+    // lacks it. Zero-copy sends always go through sendmsg
+    static TransportBackend transport();
+    static void set_transport(TransportBackend backend);
+    static bool transport_supported(TransportBackend backend);
+    static const char* transport_name(TransportBackend backend);
+    
     // Get local IP address
     static std::string get_local_ip();
     
-    // Serialize message to bytes
+    // Address and port of the socket's peer
+    static void get_peer_address(int socket, std::string& ip, int& port);
+    
+    // Port the socket is bound to
+    static int get_local_port(int socket);
+    
+    // Serialize message to bytes (its frames back to back)
     static std::vector<uint8_t> serialize_message(const Message& message);
     
     // Deserialize bytes to message
     static Message deserialize_message(const std::vector<uint8_t>& data);
 
 private:
+    // Frame header: type, flags and 64-bit big-endian payload length
+    static constexpr size_t FRAME_HEADER_SIZE = 10;
+    static constexpr uint8_t FRAME_CONTINUES = 0x01; // Another frame of the message follows
+    // First frame of a message of several frames: the header is followed by the
+    // message's total length (64-bit big-endian), so the receiver sizes it once
+    static constexpr uint8_t FRAME_TOTAL = 0x02;
+    static constexpr size_t FRAME_TOTAL_SIZE = 8;
+    
+    // Smaller sends are copied: pinning pages and the completion round trip cost more
+    static constexpr size_t ZEROCOPY_MIN_BYTES = 64 * 1024;
+    
+    // Frames a message of size bytes is split into (an empty message is one frame)
+    static size_t frame_count(uint64_t size);
+    
+    struct FrameHeader {
+        MessageType type;
+        uint8_t flags;
+        uint64_t size;
+    };
+    
+    static void write_frame_header(uint8_t* out, MessageType type, uint8_t flags, uint64_t size);
+    static FrameHeader parse_frame_header(const uint8_t* in);
+    
+    // Receive one frame header and check its length against MAX_FRAME_SIZE
+    static FrameHeader receive_frame_header(int socket);
+    
+    // Length of the message that starts with frame first, receiving the total
+    // that follows its header if it has one
+    static uint64_t receive_message_total(int socket, const FrameHeader& first);
+    
+    // Wait until the kernel reports completion of sends MSG_ZEROCOPY sends
+    static void wait_zerocopy(int socket, uint32_t sends);
+    
+    // Block until a socket that returned EAGAIN is ready for events (POLLIN or
+    // POLLOUT); throws NetworkException after SOCKET_TIMEOUT seconds
+    static void wait_ready(int socket, short events);
+
     // Send all data (handles partial sends)
     static void send_all(int socket, const void* data, size_t size);
     
@@ -101,7 +192,7 @@ private:
 class SocketConnection {
 public:
     // Constructor for server-side (garbler)
-    explicit SocketConnection(int port);
+    explicit SocketConnection(int port, int backlog = 1);
     
     // Constructor for client-side (evaluator)
     SocketConnection(const std::string& hostname, int port);
@@ -124,10 +215,23 @@ public:
     // Wait for client (server-side only)
     void wait_for_client();
     
+    // Accept the next client as a connection of its own and keep listening, for
+    // serving several sessions on one port (server-side only)
+    std::unique_ptr<SocketConnection> accept_connection();
+    
+    // Wait up to timeout_ms for a client to accept (server-side only)
+    bool wait_for_connection(int timeout_ms);
+    
+    // Port the server is listening on (server-side only)
+    int local_port() const;
+    
     // Close connection
     void close();
 
 private:
+    // Accepted connection without a listening socket
+    SocketConnection() : server_socket(-1), comm_socket(-1), is_server(true) {}
+    
     int server_socket;  // Server listening socket (garbler only)
     int comm_socket;    // Communication socket (both)
     bool is_server;     // True if this is server-side connection
@@ -159,12 +263,25 @@ public:
     // Receive hello message
     std::string receive_hello();
     
-    // Send circuit (garbler -> evaluator)
+    // Send circuit (garbler -> evaluator): the description frames and the table
+    // arena go out in one gathered send, straight from their buffers
     void send_circuit(const GarbledCircuit& garbled_circuit);
     
+    // The two parts of send_circuit(): the description, then the table arena in
+    // order as consecutive chunks, sent unframed
+    void send_circuit_description(const GarbledCircuit& garbled_circuit);
+    void send_table_chunk(const uint8_t* data, size_t size);
+    
     // Receive circuit (evaluator <- garbler)
     GarbledCircuit receive_circuit();
     
+    // The parts of receive_circuit(): the description and table layout, then the
+    // whole arena at once (receive_tables) or in consecutive chunks. The tables of
+    // a streamed circuit come after the input labels and OT
+    GarbledCircuit receive_circuit_description();
+    void receive_tables(GarbledCircuit& gc);
+    void receive_table_chunk(uint8_t* data, size_t size);
+    
     // Send input labels (garbler -> evaluator)
     void send_input_labels(const std::vector<WireLabel>& labels);
     
@@ -188,14 +305,56 @@ public:
     
     // Check if connection is still alive
     bool is_connected() const;
+    
+    // Send large buffers (circuit description, tables) with MSG_ZEROCOPY from now
+    // on; false, and copying sends as before, if the kernel does not support it
+    bool enable_zerocopy();
+    
+    // Open count parallel data connections for the garbled tables (garbler):
+    // listens on an ephemeral port of its own for them, announces it with a
+    // STRIPES message and accepts the evaluator's connections. From
+    // then on the tables are cut into chunks of at most STRIPE_CHUNK_BYTES that
+    // go round-robin over the data connections, each with its sequence number,
+    // and are put back in order on the evaluator. Control messages stay on this
+    // connection. The evaluator connects them while receiving the description
+    void open_stripes(size_t count);
+    size_t stripe_count() const { return stripes_.size(); }
     std::unique_ptr<SocketConnection> connection;
     
 
 private:
     
-    // Serialize garbled circuit for network transmission
+    // Log and serialize the description for sending
+    std::vector<uint8_t> describe_circuit(const GarbledCircuit& garbled_circuit);
+    
+    // Serialize the circuit description (header, wires, gates) of a garbled circuit;
+    // the garbled tables follow on the wire straight from GarbledCircuit::tables
     std::vector<uint8_t> serialize_garbled_circuit(const GarbledCircuit& gc);
     
-    // Deserialize network data to garbled circuit
-    GarbledCircuit deserialize_garbled_circuit(const std::vector<uint8_t>& data);
+    // Deserialize a circuit description and compute its table layout (no arena yet)
+    GarbledCircuit deserialize_garbled_circuit(const MessageBuffer& data);
+    
+    // Connect the data connections of a STRIPES message to the garbler (evaluator)
+    void join_stripes(const Message& msg);
+    
+    // The whole arena over all data connections at once, one thread per connection
+    void send_striped(const uint8_t* data, size_t size);
+    void receive_striped(uint8_t* data, size_t size);
+    
+    // One chunk with its header (sequence number, length) on the data connection
+    // it is assigned to; the receiver checks both against what it expects
+    void send_stripe_chunk(uint64_t seq, const uint8_t* data, size_t size);
+    void receive_stripe_chunk(uint64_t seq, uint8_t* data, size_t size);
+    
+    // Sequence number (8 bytes) and length (4 bytes), big-endian
+    static constexpr size_t STRIPE_HEADER_SIZE = 12;
+    // A data connection opens with its index (4 bytes, big-endian) and the
+    // session token announced on the control connection
+    static constexpr size_t STRIPE_JOIN_SIZE = 4 + WIRE_LABEL_SIZE;
+    // ...within this long of connecting, so a silent client cannot hold up the rest
+    static constexpr int STRIPE_JOIN_TIMEOUT_MS = 3000;
+    
+    bool zerocopy_ = false;
+    std::vector<std::unique_ptr<SocketConnection>> stripes_;
+    uint64_t stripe_seq_ = 0; // Next chunk of the tables
 };
@@ -0,0 +1,146 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t num_threads)
+    : num_workers_(num_threads == 0 ? hardware_threads() : num_threads),
+      ranges_(new ChunkRange[num_workers_]) {
+    threads_.reserve(num_workers_ - 1);
+    for (size_t w = 1; w < num_workers_; ++w) {
+        threads_.emplace_back(&ThreadPool::worker_loop, this, w);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    job_ready_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+size_t ThreadPool::hardware_threads() {
+    return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+void ThreadPool::parallel_for(size_t n, size_t grain, const std::function<void(size_t, size_t, size_t)>& fn) {
+    if (n == 0) {
+        return;
+    }
+    grain = std::max<size_t>(1, grain);
+    size_t chunks = (n + grain - 1) / grain;
+
+    // Nothing to share: run inline without waking the workers
+    if (num_workers_ == 1 || chunks == 1) {
+        for (size_t c = 0; c < chunks; ++c) {
+            fn(c * grain, std::min(n, (c + 1) * grain), 0);
+        }
+        return;
+    }
+
+    // Deal each worker an equal contiguous run of chunks
+    for (size_t w = 0; w < num_workers_; ++w) {
+        std::lock_guard<std::mutex> lock(ranges_[w].mutex);
+        ranges_[w].next = chunks * w / num_workers_;
+        ranges_[w].end = chunks * (w + 1) / num_workers_;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_fn_ = &fn;
+        job_n_ = n;
+        job_grain_ = grain;
+        job_error_ = nullptr;
+        job_failed_.store(false, std::memory_order_relaxed);
+        busy_workers_ = num_workers_ - 1;
+        generation_++;
+    }
+    job_ready_.notify_all();
+
+    run_chunks(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    job_done_.wait(lock, [this] { return busy_workers_ == 0; });
+    job_fn_ = nullptr;
+    if (job_error_) {
+        std::rethrow_exception(job_error_);
+    }
+}
+
+void ThreadPool::worker_loop(size_t worker) {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            job_ready_.wait(lock, [this, seen] { return stopping_ || generation_ != seen; });
+            if (stopping_) {
+                return;
+            }
+            seen = generation_;
+        }
+
+        run_chunks(worker);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--busy_workers_ == 0) {
+            job_done_.notify_one();
+        }
+    }
+}
+
+void ThreadPool::run_chunks(size_t worker) {
+    size_t chunk;
+    while (take_chunk(worker, chunk)) {
+        if (job_failed_.load(std::memory_order_relaxed)) {
+            continue; // drain the remaining chunks without running them
+        }
+        try {
+            (*job_fn_)(chunk * job_grain_, std::min(job_n_, (chunk + 1) * job_grain_), worker);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!job_error_) {
+                job_error_ = std::current_exception();
+            }
+            job_failed_.store(true, std::memory_order_relaxed);
+        }
+    }
+}
+
+bool ThreadPool::take_chunk(size_t worker, size_t& chunk) {
+    // Own run first, from the front
+    {
+        ChunkRange& own = ranges_[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (own.next < own.end) {
+            chunk = own.next++;
+            return true;
+        }
+    }
+
+    // Steal the back half of the first victim with work left
+    for (size_t k = 1; k < num_workers_; ++k) {
+        size_t victim = (worker + k) % num_workers_;
+        size_t begin, end;
+        {
+            ChunkRange& other = ranges_[victim];
+            std::lock_guard<std::mutex> lock(other.mutex);
+            size_t left = other.end - other.next;
+            if (left == 0) {
+                continue;
+            }
+            size_t take = (left + 1) / 2;
+            begin = other.end - take;
+            end = other.end;
+            other.end = begin;
+        }
+        chunk = begin;
+        ChunkRange& own = ranges_[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        own.next = begin + 1;
+        own.end = end;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "common.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/**
+ * Work-stealing thread pool for level-parallel garbling and evaluation.
+ * parallel_for() splits [0, n) into chunks and deals each worker a contiguous
+ * run of them; a worker that runs dry steals half of the remaining run of
+ * another. The calling thread takes part as worker 0, so a pool of size 1
+ * spawns no threads and runs everything inline.
+ */
+class ThreadPool {
+public:
+    // Total worker count including the caller; 0 means one per hardware thread
+    explicit ThreadPool(size_t num_threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return num_workers_; }
+
+    // Run fn(begin, end, worker) over [0, n) in chunks of up to grain items and
+    // block until all chunks are done. worker < size() identifies the thread, for
+    // per-thread scratch state. The first exception thrown by fn is rethrown here
+    void parallel_for(size_t n, size_t grain, const std::function<void(size_t, size_t, size_t)>& fn);
+
+    static size_t hardware_threads();
+
+private:
+    // Chunk indices [next, end) still owned by one worker
+    struct alignas(64) ChunkRange {
+        std::mutex mutex;
+        size_t next = 0;
+        size_t end = 0;
+    };
+
+    void worker_loop(size_t worker);
+    void run_chunks(size_t worker);
+    bool take_chunk(size_t worker, size_t& chunk);
+
+    size_t num_workers_;
+    std::vector<std::thread> threads_;
+    std::unique_ptr<ChunkRange[]> ranges_;
+
+    // Current job, published under mutex_ and identified by generation_
+    std::mutex mutex_;
+    std::condition_variable job_ready_;
+    std::condition_variable job_done_;
+    uint64_t generation_ = 0;
+    size_t busy_workers_ = 0;
+    bool stopping_ = false;
+    const std::function<void(size_t, size_t, size_t)>* job_fn_ = nullptr;
+    size_t job_n_ = 0;
+    size_t job_grain_ = 1;
+    std::exception_ptr job_error_;
+    std::atomic<bool> job_failed_{false};
+};
+
+/**
+ * Blocking FIFO of bounded capacity between one producer and one consumer
+ * thread, e.g. the garbler and its sender. push() waits while the queue is full
+ * and pop() while it is empty; after close() pushes fail and pop() drains what
+ * is left, so either side can stop the other.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(capacity == 0 ? 1 : capacity) {}
+    
+    // False if the queue was closed; the item is dropped
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this] { return closed_ || items_.size() < capacity_; });
+        if (closed_) {
+            return false;
+        }
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+        return true;
+    }
+    
+    // False once the queue is closed and empty
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+        return take(item);
+    }
+    
+    // Non-blocking pop; false if nothing is queued
+    bool try_pop(T& item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return take(item);
+    }
+    
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+private:
+    bool take(T& item) {
+        if (items_.empty()) {
+            return false;
+        }
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+    
+    std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+    std::deque<T> items_;
+    size_t capacity_;
+    bool closed_ = false;
+};
@@ -0,0 +1,348 @@
+#include "uring_transport.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+int io_uring_setup(unsigned entries, struct io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int io_uring_register(int fd, unsigned opcode, const void* arg, unsigned nr_args) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+// Ring indices are shared with the kernel
+unsigned load_acquire(const unsigned* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+void store_release(unsigned* p, unsigned v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+
+[[noreturn]] void throw_uring_error(const std::string& operation, int err) {
+    throw NetworkException(operation + " failed: " + std::strerror(err) + " (errno=" + std::to_string(err) + ")");
+}
+
+// Same wait as SocketUtils::wait_ready, for a chain that made no progress
+void wait_ready(int fd, short events) {
+    struct pollfd pfd = {fd, events, 0};
+    int ready;
+    do {
+        ready = poll(&pfd, 1, SOCKET_TIMEOUT * 1000);
+    } while (ready < 0 && errno == EINTR);
+    if (ready < 0) {
+        throw_uring_error("poll", errno);
+    }
+    if (ready == 0) {
+        throw NetworkException("Timed out waiting for the socket");
+    }
+}
+
+} // namespace
+
+IoUring::IoUring(unsigned entries) {
+    struct io_uring_params params = {};
+    ring_fd_ = io_uring_setup(entries, &params);
+    if (ring_fd_ < 0) {
+        throw_uring_error("io_uring_setup", errno);
+    }
+    sq_entries_ = params.sq_entries;
+    cq_entries_ = params.cq_entries;
+
+    // Rings and SQE array live in kernel memory mapped into the process; newer
+    // kernels map both rings at once
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+        sq_ring_ = nullptr;
+        int err = errno;
+        release();
+        throw_uring_error("io_uring SQ ring mmap", err);
+    }
+    if (single_mmap) {
+        cq_ring_ = sq_ring_;
+    } else {
+        cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED) {
+            cq_ring_ = nullptr;
+            int err = errno;
+            release();
+            throw_uring_error("io_uring CQ ring mmap", err);
+        }
+    }
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring_fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        int err = errno;
+        release();
+        throw_uring_error("io_uring SQE mmap", err);
+    }
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    auto* sq = static_cast<uint8_t*>(sq_ring_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    auto* cq = static_cast<uint8_t*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    results_.resize(sq_entries_);
+}
+
+IoUring::~IoUring() {
+    release();
+}
+
+void IoUring::release() {
+    if (sqes_ != nullptr) {
+        munmap(sqes_, sqes_size_);
+        sqes_ = nullptr;
+    }
+    if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) {
+        munmap(cq_ring_, cq_ring_size_);
+    }
+    cq_ring_ = nullptr;
+    if (sq_ring_ != nullptr) {
+        munmap(sq_ring_, sq_ring_size_);
+        sq_ring_ = nullptr;
+    }
+    if (ring_fd_ >= 0) {
+        close(ring_fd_); // Also drops registered buffers
+        ring_fd_ = -1;
+    }
+}
+
+bool IoUring::supported() {
+    static const bool available = [] {
+        struct io_uring_params params = {};
+        int fd = io_uring_setup(1, &params);
+        if (fd < 0) {
+            return false;
+        }
+        close(fd);
+        return true;
+    }();
+    return available;
+}
+
+IoUring& IoUring::thread_ring() {
+    thread_local std::unique_ptr<IoUring> ring;
+    if (!ring) {
+        ring = std::make_unique<IoUring>();
+    }
+    return *ring;
+}
+
+void IoUring::send_all(int fd, const void* data, size_t size) {
+    struct iovec iov = {const_cast<void*>(data), size};
+    transfer(fd, true, &iov, 1);
+}
+
+void IoUring::receive_all(int fd, void* data, size_t size) {
+    struct iovec iov = {data, size};
+    transfer(fd, false, &iov, 1);
+}
+
+void IoUring::send_gather(int fd, const struct iovec* iov, size_t count) {
+    transfer(fd, true, iov, count);
+}
+
+bool IoUring::register_buffers(const struct iovec* iov, size_t count) {
+    unregister_buffers();
+    if (io_uring_register(ring_fd_, IORING_REGISTER_BUFFERS, iov, static_cast<unsigned>(count)) < 0) {
+        LOG_WARNING("io_uring buffer registration failed (" << std::strerror(errno)
+                    << "); using unregistered transfers");
+        return false;
+    }
+    fixed_buffers_.assign(iov, iov + count);
+    return true;
+}
+
+void IoUring::unregister_buffers() {
+    if (fixed_buffers_.empty()) {
+        return;
+    }
+    io_uring_register(ring_fd_, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+    fixed_buffers_.clear();
+}
+
+int IoUring::fixed_buffer_index(const uint8_t* data, size_t size) const {
+    for (size_t i = 0; i < fixed_buffers_.size(); ++i) {
+        const auto* base = static_cast<const uint8_t*>(fixed_buffers_[i].iov_base);
+        if (data >= base && data + size <= base + fixed_buffers_[i].iov_len) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+void IoUring::transfer(int fd, bool sending, const struct iovec* iov, size_t count) {
+    std::vector<Segment> segments;
+    for (size_t i = 0; i < count; ++i) {
+        auto* data = static_cast<uint8_t*>(iov[i].iov_base);
+        for (size_t offset = 0; offset < iov[i].iov_len; offset += SEGMENT_BYTES) {
+            segments.push_back({data + offset, std::min(SEGMENT_BYTES, iov[i].iov_len - offset)});
+        }
+    }
+
+    // Up to a ring's worth of segments per submission; after a short one the
+    // rest is resubmitted from the byte where it stopped
+    size_t next = 0;
+    size_t next_done = 0;
+    while (next < segments.size()) {
+        size_t n = std::min<size_t>(segments.size() - next, sq_entries_);
+        size_t done = submit_chain(fd, sending, segments.data() + next, n, next_done);
+        if (done == 0) {
+            // The first segment was interrupted or would block; resubmitting
+            // straight away would spin, so wait for the socket first
+            wait_ready(fd, sending ? POLLOUT : POLLIN);
+            continue;
+        }
+        while (done > 0) {
+            size_t left = segments[next].size - next_done;
+            if (done < left) {
+                next_done += done;
+                break;
+            }
+            done -= left;
+            next++;
+            next_done = 0;
+        }
+    }
+}
+
+size_t IoUring::submit_chain(int fd, bool sending, const Segment* segments, size_t n, size_t first_done) {
+    unsigned tail = *sq_tail_;
+    for (size_t i = 0; i < n; ++i) {
+        unsigned index = (tail + static_cast<unsigned>(i)) & sq_mask_;
+        struct io_uring_sqe* sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+
+        uint8_t* data = segments[i].data + (i == 0 ? first_done : 0);
+        size_t size = segments[i].size - (i == 0 ? first_done : 0);
+        int fixed = sending ? -1 : fixed_buffer_index(data, size);
+        if (fixed >= 0) {
+            // Short reads fail the link, so later segments cannot land out of place
+            sqe->opcode = IORING_OP_READ_FIXED;
+            sqe->buf_index = static_cast<uint16_t>(fixed);
+        } else {
+            // Sends stay on SEND: a write to a closed socket would raise SIGPIPE.
+            // MSG_WAITALL makes a partial transfer fail the link as well
+            sqe->opcode = sending ? IORING_OP_SEND : IORING_OP_RECV;
+            sqe->msg_flags = MSG_WAITALL | (sending ? MSG_NOSIGNAL : 0);
+        }
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(data);
+        sqe->len = static_cast<uint32_t>(size);
+        sqe->user_data = i;
+        if (i + 1 < n) {
+            sqe->flags = IOSQE_IO_LINK;
+        }
+        sq_array_[index] = index;
+    }
+    store_release(sq_tail_, tail + static_cast<unsigned>(n));
+
+    // One syscall submits the chain and waits; cancelled links complete too
+    unsigned to_submit = static_cast<unsigned>(n);
+    size_t completed = 0;
+    while (completed < n) {
+        int ret = io_uring_enter(ring_fd_, to_submit, static_cast<unsigned>(n - completed), IORING_ENTER_GETEVENTS);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw_uring_error("io_uring_enter", errno);
+        }
+        to_submit -= std::min<unsigned>(to_submit, static_cast<unsigned>(ret));
+
+        unsigned head = *cq_head_;
+        unsigned cq_tail = load_acquire(cq_tail_);
+        for (; head != cq_tail; ++head) {
+            const struct io_uring_cqe& cqe = cqes_[head & cq_mask_];
+            results_[cqe.user_data] = cqe.res;
+            completed++;
+        }
+        store_release(cq_head_, head);
+    }
+
+    // Bytes done up to the first segment that fell short
+    size_t done = 0;
+    for (size_t i = 0; i < n; ++i) {
+        size_t expected = segments[i].size - (i == 0 ? first_done : 0);
+        int res = results_[i];
+        if (res < 0) {
+            if (res == -ECANCELED || res == -EINTR || res == -EAGAIN) {
+                break;
+            }
+            throw_uring_error(sending ? "io_uring send" : "io_uring recv", -res);
+        }
+        if (res == 0 && expected > 0) {
+            throw NetworkException(sending ? "Connection accepted no data" : "Connection closed by peer");
+        }
+        done += static_cast<size_t>(res);
+        if (static_cast<size_t>(res) < expected) {
+            break;
+        }
+    }
+    return done;
+}
+
+#else // !__linux__
+
+IoUring::IoUring(unsigned) {
+    throw NetworkException("io_uring is only available on Linux");
+}
+
+IoUring::~IoUring() = default;
+
+bool IoUring::supported() { return false; }
+
+IoUring& IoUring::thread_ring() {
+    throw NetworkException("io_uring is only available on Linux");
+}
+
+void IoUring::send_all(int, const void*, size_t) {}
+void IoUring::receive_all(int, void*, size_t) {}
+void IoUring::send_gather(int, const struct iovec*, size_t) {}
+bool IoUring::register_buffers(const struct iovec*, size_t) { return false; }
+void IoUring::unregister_buffers() {}
+
+#endif // __linux__
+
+IoUring::BufferRegistration::BufferRegistration(IoUring& ring, void* data, size_t size)
+    : ring_(ring), registered_(false) {
+    if (size > 0) {
+        struct iovec iov = {data, size};
+        registered_ = ring_.register_buffers(&iov, 1);
+    }
+}
+
+IoUring::BufferRegistration::~BufferRegistration() {
+    if (registered_) {
+        ring_.unregister_buffers();
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "common.h"
+#include <sys/uio.h>
+
+/**
+ * Minimal io_uring ring for socket transfers, on raw syscalls (no liburing).
+ * A transfer is cut into segments of at most SEGMENT_BYTES that are submitted
+ * as one linked batch with a single io_uring_enter() and driven by their
+ * completions: a short segment cancels the rest of the chain, which is then
+ * resubmitted from where it stopped. Segments inside a registered buffer use
+ * the fixed-buffer opcodes, so their pages are not pinned again per I/O.
+ * Not thread-safe; thread_ring() gives each thread a ring of its own.
+ */
+class IoUring {
+public:
+    explicit IoUring(unsigned entries = DEFAULT_ENTRIES);
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // Whether the kernel allows io_uring (it may be missing or disabled)
+    static bool supported();
+
+    // This thread's ring, created on first use
+    static IoUring& thread_ring();
+
+    // Send or receive exactly the given bytes on a connected stream socket.
+    // Throws NetworkException on errors and when the peer closes the connection
+    void send_all(int fd, const void* data, size_t size);
+    void receive_all(int fd, void* data, size_t size);
+    void send_gather(int fd, const struct iovec* iov, size_t count);
+
+    // Register buffers for fixed-buffer transfers, replacing earlier ones.
+    // Pinning can fail (e.g. RLIMIT_MEMLOCK); then false, and transfers into
+    // them simply use the ordinary opcodes
+    bool register_buffers(const struct iovec* iov, size_t count);
+    void unregister_buffers();
+
+    // Keeps one buffer registered while in scope, e.g. a table arena for the
+    // length of its transfer. The registration must end before the buffer is freed
+    class BufferRegistration {
+    public:
+        BufferRegistration(IoUring& ring, void* data, size_t size);
+        ~BufferRegistration();
+
+        BufferRegistration(const BufferRegistration&) = delete;
+        BufferRegistration& operator=(const BufferRegistration&) = delete;
+
+        bool registered() const { return registered_; }
+
+    private:
+        IoUring& ring_;
+        bool registered_;
+    };
+
+private:
+    static constexpr unsigned DEFAULT_ENTRIES = 64;
+    static constexpr size_t SEGMENT_BYTES = 256 * 1024;
+
+    // One SQE's worth of a transfer
+    struct Segment {
+        uint8_t* data;
+        size_t size;
+    };
+
+    // Unmap the rings and close the ring descriptor
+    void release();
+
+    void transfer(int fd, bool sending, const struct iovec* iov, size_t count);
+
+    // Submit segments[first, first + n) as a linked chain and wait for all of
+    // them; returns the bytes done from the start of segments[first]
+    size_t submit_chain(int fd, bool sending, const Segment* segments, size_t n, size_t first_done);
+
+    // Index of the registered buffer holding [data, data + size), or -1
+    int fixed_buffer_index(const uint8_t* data, size_t size) const;
+
+    int ring_fd_ = -1;
+    unsigned sq_entries_ = 0;
+    unsigned cq_entries_ = 0;
+
+    // Mapped ring memory
+    void* sq_ring_ = nullptr;
+    size_t sq_ring_size_ = 0;
+    void* cq_ring_ = nullptr;
+    size_t cq_ring_size_ = 0;
+    struct io_uring_sqe* sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned* sq_array_ = nullptr;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    struct io_uring_cqe* cqes_ = nullptr;
+
+    std::vector<struct iovec> fixed_buffers_;
+
+    // Per-segment results of the chain in flight
+    std::vector<int> results_;
+};